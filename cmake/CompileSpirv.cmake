@@ -0,0 +1,40 @@
+# Compiles every kernel variant in SOURCE_DIR to SPIR-V in OUTPUT_DIR:
+#   cmake -DCLANG=... -DLLVM_SPIRV=... -DSOURCE_DIR=... -DOUTPUT_DIR=... -P CompileSpirv.cmake
+# The math flags match Renderer::generateCompilerOptions; the device build of
+# the IL applies the vendor-specific ones. The front end uses CL2.0, the
+# lowest standard the renderer compiles with, so the module also loads on
+# devices without full OpenCL 3.0 support; -cl-std has no effect on an IL
+# build, and the kernels use no 3.0-only features.
+
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+file(GLOB OLD_MODULES "${OUTPUT_DIR}/*.spv")
+if(OLD_MODULES)
+    file(REMOVE ${OLD_MODULES})
+endif()
+
+file(GLOB VARIANTS "${SOURCE_DIR}/*.spv.cl")
+foreach(VARIANT ${VARIANTS})
+    get_filename_component(NAME "${VARIANT}" NAME)
+    string(REGEX REPLACE "\\.cl$" "" MODULE "${NAME}")
+    set(BITCODE "${SOURCE_DIR}/${MODULE}.bc")
+
+    execute_process(
+        COMMAND "${CLANG}" -c -x cl -cl-std=CL2.0 -target spir64 -emit-llvm -O2
+                -Xclang -finclude-default-header
+                -cl-mad-enable -cl-fast-relaxed-math -cl-finite-math-only -cl-single-precision-constant
+                -o "${BITCODE}" "${VARIANT}"
+        RESULT_VARIABLE RESULT
+    )
+    if(NOT RESULT EQUAL 0)
+        message(WARNING "Offline compilation of ${NAME} failed; it will be built from source at run time")
+        continue()
+    endif()
+
+    execute_process(
+        COMMAND "${LLVM_SPIRV}" "${BITCODE}" -o "${OUTPUT_DIR}/${MODULE}"
+        RESULT_VARIABLE RESULT
+    )
+    if(NOT RESULT EQUAL 0)
+        message(WARNING "SPIR-V translation of ${NAME} failed; it will be built from source at run time")
+    endif()
+endforeach()
@@ -0,0 +1,32 @@
+# Generates the table of embedded kernel sources from KERNEL_DIR/*.cl:
+#   cmake -DKERNEL_DIR=... -DOUTPUT=... -P EmbedKernels.cmake
+# Files are stored as byte arrays, which unlike string literals have no
+# length limit on any compiler.
+
+file(GLOB KERNEL_FILES RELATIVE "${KERNEL_DIR}" "${KERNEL_DIR}/*.cl")
+list(SORT KERNEL_FILES)
+
+set(CONTENT "// Generated by cmake/EmbedKernels.cmake from kernels/*.cl, do not edit\n")
+string(APPEND CONTENT "#include \"Graphics/KernelSource.h\"\n\n")
+set(TABLE "")
+set(INDEX 0)
+foreach(FILE ${KERNEL_FILES})
+    file(READ "${KERNEL_DIR}/${FILE}" HEX HEX)
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR SIZE "${HEX_LENGTH} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+    string(APPEND CONTENT "static const unsigned char kKernel${INDEX}[] = {${BYTES}0x00};\n")
+    string(APPEND TABLE "    {\"${FILE}\", kKernel${INDEX}, ${SIZE}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+string(APPEND CONTENT "\nconst EmbeddedKernelFile kEmbeddedKernels[] = {\n${TABLE}};\n")
+string(APPEND CONTENT "const size_t kEmbeddedKernelCount = ${INDEX};\n")
+
+# Rewritten only on change, so unrelated kernel edits don't relink twice
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" PREVIOUS)
+endif()
+if(NOT "${PREVIOUS}" STREQUAL "${CONTENT}")
+    file(WRITE "${OUTPUT}" "${CONTENT}")
+endif()
@@ -0,0 +1,18 @@
+// Camera rays
+#include "common.cl"
+
+// Rotate a vector by a unit quaternion
+inline float3 rotate_by_quaternion(float4 q, float3 v) {
+    float3 t = 2.0f * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+// Unit direction of the camera ray through pixel (x, y)
+float3 camera_ray_direction(Camera camera, int x, int y) {
+    float ndc_x = (2.0f * x / (float)camera.width) - 1.0f;
+    float ndc_y = 1.0f - (2.0f * y / (float)camera.height);
+    
+    float tan_half_fov = tan(camera.fov * 0.5f);
+    float3 local_dir = (float3)(ndc_x * tan_half_fov * camera.aspect, ndc_y * tan_half_fov, 1.0f);
+    return normalize(rotate_by_quaternion(camera.orientation, local_dir));
+}
@@ -0,0 +1,94 @@
+// Ray state layout, flags, camera and output definitions shared by every module
+
+// Ray state is stored as a structure of arrays, indexed by work-item:
+//   positions[i]  float4 (t, x, y, z)
+//   velocities[i] float4 (dt/dλ, dx/dλ, dy/dλ, dz/dλ)
+//   flags[i]      uchar, RAY_* bits
+//   step_sizes[i] float, adaptive step carried between rounds and frames
+// Rays are ordered tile by tile (TILE_WIDTH x TILE_HEIGHT, the work-group
+// shape), so the rays of one work-group are contiguous in every stream.
+#define RAY_TERMINATED 0x01
+#define RAY_CAPTURED 0x02 // Fell through the horizon
+
+// Fraction below the critical impact parameter within which capture is
+// treated as certain; rays closer to it are integrated
+#ifndef CAPTURE_MARGIN
+#define CAPTURE_MARGIN 0.02f
+#endif
+
+// Wavefront mode keeps the indices of live rays in an active list, compacted
+// between rounds with a prefix sum over SCAN_BLOCK_SIZE-wide blocks
+#ifndef SCAN_BLOCK_SIZE
+#define SCAN_BLOCK_SIZE 256
+#endif
+
+#ifndef TILE_WIDTH
+#define TILE_WIDTH 8
+#endif
+#ifndef TILE_HEIGHT
+#define TILE_HEIGHT 8
+#endif
+
+// Index of the ray for pixel (x, y) in tile-major order
+inline int ray_index(int x, int y, int width) {
+    int tiles_x = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    int tile = (y / TILE_HEIGHT) * tiles_x + (x / TILE_WIDTH);
+    return tile * (TILE_WIDTH * TILE_HEIGHT) + (y % TILE_HEIGHT) * TILE_WIDTH + (x % TILE_WIDTH);
+}
+
+// Camera uniform block
+typedef struct {
+    float4 position;    // Observer position (t, x, y, z)
+    float4 orientation; // Orientation quaternion (x, y, z, w)
+    float fov;          // Vertical field of view in radians
+    float aspect;       // Width / height
+    int width, height;  // Image dimensions in pixels
+} Camera;
+
+// Standard math constants
+#define PI_F 3.14159265358979323846f
+
+// Output target: a plain host-visible buffer on CPU devices (zero-copy),
+// otherwise an image that the host reads back. On the buffer path pixels are
+// packed here to the selected OUTPUT_FORMAT_*; images convert on write.
+#ifdef OUTPUT_TO_BUFFER
+#if defined(OUTPUT_FORMAT_RGBA8)
+#define OUTPUT_TYPE __global uchar4*
+#elif defined(OUTPUT_FORMAT_RGBA16F)
+#define OUTPUT_TYPE __global half*
+#elif defined(OUTPUT_FORMAT_RGB10A2)
+#define OUTPUT_TYPE __global uint*
+#else
+#define OUTPUT_TYPE __global float4*
+#endif
+#else
+#define OUTPUT_TYPE __write_only image2d_t
+#endif
+
+inline void store_pixel(OUTPUT_TYPE output, int index, int2 coords, float4 color) {
+#ifdef OUTPUT_TO_BUFFER
+#if defined(OUTPUT_FORMAT_RGBA8)
+    output[index] = convert_uchar4_sat_rte(color * 255.0f);
+#elif defined(OUTPUT_FORMAT_RGBA16F)
+    vstore_half4_rte(color, index, output);
+#elif defined(OUTPUT_FORMAT_RGB10A2)
+    // Same layout as CL_UNORM_INT_101010: R in bits 29-20, G 19-10, B 9-0
+    uint3 c = convert_uint3_sat_rte(color.xyz * 1023.0f);
+    output[index] = (c.x << 20) | (c.y << 10) | c.z;
+#else
+    output[index] = color;
+#endif
+#else
+    write_imagef(output, coords, color);
+#endif
+}
+
+// Trace settings, mirrored by TraceParams on the host
+typedef struct {
+    float step_size;     // Affine parameter step, the initial step when adaptive
+    float escape_radius; // Rays beyond this radius have escaped
+    float abs_tolerance; // Adaptive error control
+    float rel_tolerance;
+    float horizon_radius; // Rays inside are captured, 0 without a horizon
+    int max_steps;       // Integration steps (attempts when adaptive) per ray
+} TraceParams;
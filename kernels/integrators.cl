@@ -0,0 +1,201 @@
+// Geodesic integrators: RK4, Dormand-Prince and the symplectic Hamiltonian step
+#include "metric.cl"
+
+// Integrator, selected at build time: INTEGRATOR_RK4 uses fixed steps,
+// INTEGRATOR_DOPRI5 adapts the step to the local error (the default),
+// INTEGRATOR_SYMPLECTIC takes fixed Hamiltonian steps that stay null.
+// KERR_MINO (with KERR_MASS and KERR_SPIN) replaces all three for Kerr
+// metrics by the separated equations of motion in Mino time.
+#if !defined(INTEGRATOR_RK4) && !defined(INTEGRATOR_DOPRI5) && !defined(INTEGRATOR_SYMPLECTIC)
+#define INTEGRATOR_DOPRI5
+#endif
+
+// Fixed-point iterations of the implicit symplectic step
+#ifndef SYMPLECTIC_ITERATIONS
+#define SYMPLECTIC_ITERATIONS 3
+#endif
+
+// Classic fourth-order Runge-Kutta step of the geodesic equation
+void integrate_ray_step(__constant float* metric_data, float4* pos, float4* vel, float step_size) {
+    float4 x = *pos;
+    float4 v = *vel;
+    float h = step_size;
+    
+    float4 k1_x = v;
+    float4 k1_v = geodesic_acceleration(metric_data, x, v);
+    float4 k2_x = v + 0.5f * h * k1_v;
+    float4 k2_v = geodesic_acceleration(metric_data, x + 0.5f * h * k1_x, k2_x);
+    float4 k3_x = v + 0.5f * h * k2_v;
+    float4 k3_v = geodesic_acceleration(metric_data, x + 0.5f * h * k2_x, k3_x);
+    float4 k4_x = v + h * k3_v;
+    float4 k4_v = geodesic_acceleration(metric_data, x + h * k3_x, k4_x);
+    
+    *pos = x + (h / 6.0f) * (k1_x + 2.0f * k2_x + 2.0f * k3_x + k4_x);
+    *vel = v + (h / 6.0f) * (k1_v + 2.0f * k2_v + 2.0f * k3_v + k4_v);
+}
+
+// Dormand-Prince 5(4) coefficients
+#define DP_C2 (1.0f / 5.0f)
+#define DP_C3 (3.0f / 10.0f)
+#define DP_C4 (4.0f / 5.0f)
+#define DP_C5 (8.0f / 9.0f)
+#define DP_A21 (1.0f / 5.0f)
+#define DP_A31 (3.0f / 40.0f)
+#define DP_A32 (9.0f / 40.0f)
+#define DP_A41 (44.0f / 45.0f)
+#define DP_A42 (-56.0f / 15.0f)
+#define DP_A43 (32.0f / 9.0f)
+#define DP_A51 (19372.0f / 6561.0f)
+#define DP_A52 (-25360.0f / 2187.0f)
+#define DP_A53 (64448.0f / 6561.0f)
+#define DP_A54 (-212.0f / 729.0f)
+#define DP_A61 (9017.0f / 3168.0f)
+#define DP_A62 (-355.0f / 33.0f)
+#define DP_A63 (46732.0f / 5247.0f)
+#define DP_A64 (49.0f / 176.0f)
+#define DP_A65 (-5103.0f / 18656.0f)
+#define DP_B1 (35.0f / 384.0f)
+#define DP_B3 (500.0f / 1113.0f)
+#define DP_B4 (125.0f / 192.0f)
+#define DP_B5 (-2187.0f / 6784.0f)
+#define DP_B6 (11.0f / 84.0f)
+// Fifth minus fourth order weights, for the error estimate
+#define DP_E1 (71.0f / 57600.0f)
+#define DP_E3 (-71.0f / 16695.0f)
+#define DP_E4 (71.0f / 1920.0f)
+#define DP_E5 (-17253.0f / 339200.0f)
+#define DP_E6 (22.0f / 525.0f)
+#define DP_E7 (-1.0f / 40.0f)
+
+// Largest error component relative to its tolerance
+inline float error_ratio(float4 error, float4 y0, float4 y1, TraceParams params) {
+    float4 scale = params.abs_tolerance + params.rel_tolerance * fmax(fabs(y0), fabs(y1));
+    float4 ratio = fabs(error) / scale;
+    return fmax(fmax(ratio.x, ratio.y), fmax(ratio.z, ratio.w));
+}
+
+// One attempted Dormand-Prince step of size *h. On success the state and the
+// acceleration at the new point (first stage of the next step) advance.
+// Either way *h becomes the step size suggested by the error estimate.
+bool dopri5_step(__constant float* metric_data, float4* pos, float4* vel, float4* acc, float* h, TraceParams params) {
+    float4 x = *pos;
+    float4 v = *vel;
+    float dt = *h;
+    
+    // Stages of x' = v, v' = a(x, v); the x stages are the v values
+    float4 k1_v = *acc;
+    float4 k2_x = v + dt * (DP_A21 * k1_v);
+    float4 k2_v = geodesic_acceleration(metric_data, x + dt * (DP_A21 * v), k2_x);
+    float4 k3_x = v + dt * (DP_A31 * k1_v + DP_A32 * k2_v);
+    float4 k3_v = geodesic_acceleration(metric_data, x + dt * (DP_A31 * v + DP_A32 * k2_x), k3_x);
+    float4 k4_x = v + dt * (DP_A41 * k1_v + DP_A42 * k2_v + DP_A43 * k3_v);
+    float4 k4_v = geodesic_acceleration(metric_data, x + dt * (DP_A41 * v + DP_A42 * k2_x + DP_A43 * k3_x), k4_x);
+    float4 k5_x = v + dt * (DP_A51 * k1_v + DP_A52 * k2_v + DP_A53 * k3_v + DP_A54 * k4_v);
+    float4 k5_v = geodesic_acceleration(metric_data, x + dt * (DP_A51 * v + DP_A52 * k2_x + DP_A53 * k3_x + DP_A54 * k4_x), k5_x);
+    float4 k6_x = v + dt * (DP_A61 * k1_v + DP_A62 * k2_v + DP_A63 * k3_v + DP_A64 * k4_v + DP_A65 * k5_v);
+    float4 k6_v = geodesic_acceleration(metric_data, x + dt * (DP_A61 * v + DP_A62 * k2_x + DP_A63 * k3_x + DP_A64 * k4_x + DP_A65 * k5_x), k6_x);
+    
+    float4 x_new = x + dt * (DP_B1 * v + DP_B3 * k3_x + DP_B4 * k4_x + DP_B5 * k5_x + DP_B6 * k6_x);
+    float4 v_new = v + dt * (DP_B1 * k1_v + DP_B3 * k3_v + DP_B4 * k4_v + DP_B5 * k5_v + DP_B6 * k6_v);
+    float4 k7_v = geodesic_acceleration(metric_data, x_new, v_new);
+    
+    float4 x_error = dt * (DP_E1 * v + DP_E3 * k3_x + DP_E4 * k4_x + DP_E5 * k5_x + DP_E6 * k6_x + DP_E7 * v_new);
+    float4 v_error = dt * (DP_E1 * k1_v + DP_E3 * k3_v + DP_E4 * k4_v + DP_E5 * k5_v + DP_E6 * k6_v + DP_E7 * k7_v);
+    float error = fmax(error_ratio(x_error, x, x_new, params), error_ratio(v_error, v, v_new, params));
+    
+    // Standard controller for a fifth-order method, growth limited to 5x
+    float factor = (error > 1e-10f) ? 0.9f * pow(error, -0.2f) : 5.0f;
+    *h = dt * clamp(factor, 0.2f, 5.0f);
+    
+    if (error > 1.0f) {
+        return false;
+    }
+    *pos = x_new;
+    *vel = v_new;
+    *acc = k7_v;
+    return true;
+}
+
+// Hamiltonian form of the geodesic equation on (x^μ, p_μ), p_μ = g_μν v^ν:
+//   H = ½ g^μν p_μ p_ν = 0 for light rays
+//   dx^μ/dλ = g^μν p_ν,  dp_μ/dλ = -∂_μ H = ½ ∂_μ g_αβ v^α v^β
+
+void hamiltonian_flow(__constant float* metric_data, float4 x, float4 p, float4* dx, float4* dp) {
+    float4 v = raise_index(metric_data, x, p);
+    float q[4] = { p.x, p.y, p.z, p.w };
+    float u[4] = { v.x, v.y, v.z, v.w };
+    float force[4];
+    
+#ifdef METRIC_HAS_CHRISTOFFEL
+    // ½ ∂_μ g_αβ v^α v^β = p_σ Γ^σ_μβ v^β
+    float gamma[64];
+    christoffel_at(metric_data, x, gamma);
+    for (int mu = 0; mu < 4; ++mu) {
+        float sum = 0.0f;
+        for (int s = 0; s < 4; ++s) {
+            for (int b = 0; b < 4; ++b) {
+                sum += q[s] * gamma[s * 16 + mu * 4 + b] * u[b];
+            }
+        }
+        force[mu] = sum;
+    }
+#else
+    float dg[64];
+    metric_derivatives_at(metric_data, x, dg);
+    for (int mu = 0; mu < 4; ++mu) {
+        float sum = 0.0f;
+        for (int a = 0; a < 4; ++a) {
+            for (int b = 0; b < 4; ++b) {
+                sum += dg[mu * 16 + a * 4 + b] * u[a] * u[b];
+            }
+        }
+        force[mu] = 0.5f * sum;
+    }
+#endif
+    
+    *dx = v;
+    *dp = (float4)(force[0], force[1], force[2], force[3]);
+}
+
+// Restores H = 0 by solving for p_t with the spatial momentum kept, taking
+// the root closest to the current p_t
+float4 project_null_momentum(__constant float* metric_data, float4 x, float4 p) {
+    float g[16], g_inv[16];
+    metric_at(metric_data, x, g);
+    invert_metric(g, g_inv);
+    
+    float a = g_inv[0];
+    float b = 2.0f * (g_inv[1] * p.y + g_inv[2] * p.z + g_inv[3] * p.w);
+    float c = g_inv[5] * p.y * p.y + g_inv[10] * p.z * p.z + g_inv[15] * p.w * p.w +
+              2.0f * (g_inv[6] * p.y * p.z + g_inv[7] * p.y * p.w + g_inv[11] * p.z * p.w);
+    float discriminant = b * b - 4.0f * a * c;
+    if (discriminant < 0.0f || fabs(a) < 1e-6f) {
+        return p;
+    }
+    
+    float root = sqrt(discriminant);
+    float pt0 = (-b + root) / (2.0f * a);
+    float pt1 = (-b - root) / (2.0f * a);
+    p.x = (fabs(pt0 - p.x) < fabs(pt1 - p.x)) ? pt0 : pt1;
+    return p;
+}
+
+// Implicit midpoint step, symplectic and second order. The implicit
+// equation is solved by fixed-point iteration from an explicit Euler guess.
+void symplectic_step(__constant float* metric_data, float4* pos, float4* mom, float h) {
+    float4 x = *pos;
+    float4 p = *mom;
+    float4 dx, dp;
+    
+    hamiltonian_flow(metric_data, x, p, &dx, &dp);
+    float4 x_new = x + h * dx;
+    float4 p_new = p + h * dp;
+    for (int i = 0; i < SYMPLECTIC_ITERATIONS; ++i) {
+        hamiltonian_flow(metric_data, 0.5f * (x + x_new), 0.5f * (p + p_new), &dx, &dp);
+        x_new = x + h * dx;
+        p_new = p + h * dp;
+    }
+    
+    *pos = x_new;
+    *mom = project_null_momentum(metric_data, x_new, p_new);
+}
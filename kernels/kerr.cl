@@ -0,0 +1,164 @@
+// Kerr geodesics in Mino time, used with KERR_MINO
+#include "metric.cl"
+
+#ifdef KERR_MINO
+// Kerr photon orbits from the conserved energy E, axial angular momentum L
+// and Carter constant Q. In Mino time λ_M (dλ = Σ dλ_M) the radial and polar
+// motion decouple:
+//   (dr/dλ_M)² = R(r) = P² - Δ ((L - aE)² + Q),  P = E (r² + a²) - aL
+//   (du/dλ_M)² = U(u) = Q - (Q + L² - a²E²) u² - a²E² u⁴,  u = cos θ
+// Integrating r'' = R'/2 and u'' = U'/2 instead of the square roots passes
+// through the turning points without sign bookkeeping. φ and t are the
+// Kerr-Schild ones, so the state maps back to Cartesian without the
+// Boyer-Lindquist coordinate singularity. kerr_radius() comes with the Kerr
+// metric source.
+
+// Stop this far outside the outer horizon r+, where Δ → 0
+#ifndef KERR_HORIZON_MARGIN
+#define KERR_HORIZON_MARGIN 1.02f
+#endif
+
+typedef struct {
+    float r, dr;  // Boyer-Lindquist radius and dr/dλ_M
+    float u, du;  // cos θ and du/dλ_M
+    float phi, t; // Kerr-Schild azimuth and time
+} KerrState;
+
+typedef struct {
+    float energy, angular_momentum, carter;
+} KerrConstants;
+
+inline float kerr_delta(__constant float* metric_data, float r) {
+    return r * r - 2.0f * KERR_MASS * r + KERR_SPIN * KERR_SPIN;
+}
+
+// d/dλ_M of (r, dr, u, du, phi, t)
+void kerr_derivatives(__constant float* metric_data, KerrState s, KerrConstants k, KerrState* d) {
+    float a = KERR_SPIN;
+    float E = k.energy, L = k.angular_momentum, Q = k.carter;
+    float r2a2 = s.r * s.r + a * a;
+    float P = E * r2a2 - a * L;
+    float K = (L - a * E) * (L - a * E) + Q;
+    float delta = kerr_delta(metric_data, s.r);
+    float sin2 = max(1.0f - s.u * s.u, 1e-6f);
+    
+    d->r = s.dr;
+    d->dr = 2.0f * E * s.r * P - (s.r - KERR_MASS) * K;
+    d->u = s.du;
+    d->du = (a * a * E * E - Q - L * L) * s.u - 2.0f * a * a * E * E * s.u * s.u * s.u;
+    // Boyer-Lindquist rates plus the Kerr-Schild shifts dφ = a dr / Δ, dt = 2Mr dr / Δ
+    d->phi = a * P / delta - a * E + L / sin2 + a * s.dr / delta;
+    d->t = r2a2 * P / delta - a * (a * E * sin2 - L) + 2.0f * KERR_MASS * s.r * s.dr / delta;
+}
+
+inline KerrState kerr_offset(KerrState s, KerrState d, float h) {
+    KerrState out = { s.r + h * d.r, s.dr + h * d.dr, s.u + h * d.u,
+                      s.du + h * d.du, s.phi + h * d.phi, s.t + h * d.t };
+    return out;
+}
+
+// Classic fourth-order Runge-Kutta step in Mino time
+void kerr_step(__constant float* metric_data, KerrState* s, KerrConstants k, float h) {
+    KerrState k1, k2, k3, k4;
+    kerr_derivatives(metric_data, *s, k, &k1);
+    kerr_derivatives(metric_data, kerr_offset(*s, k1, 0.5f * h), k, &k2);
+    kerr_derivatives(metric_data, kerr_offset(*s, k2, 0.5f * h), k, &k3);
+    kerr_derivatives(metric_data, kerr_offset(*s, k3, h), k, &k4);
+    
+    float w = h / 6.0f;
+    s->r += w * (k1.r + 2.0f * k2.r + 2.0f * k3.r + k4.r);
+    s->dr += w * (k1.dr + 2.0f * k2.dr + 2.0f * k3.dr + k4.dr);
+    s->u += w * (k1.u + 2.0f * k2.u + 2.0f * k3.u + k4.u);
+    s->du += w * (k1.du + 2.0f * k2.du + 2.0f * k3.du + k4.du);
+    s->phi += w * (k1.phi + 2.0f * k2.phi + 2.0f * k3.phi + k4.phi);
+    s->t += w * (k1.t + 2.0f * k2.t + 2.0f * k3.t + k4.t);
+    s->u = clamp(s->u, -1.0f, 1.0f);
+}
+
+// Kerr-Schild Cartesian position and velocity to the Mino-time state and
+// the constants of motion
+void kerr_from_cartesian(__constant float* metric_data, float4 x, float4 v,
+                         KerrState* s, KerrConstants* k) {
+    float a = KERR_SPIN;
+    float3 p = x.yzw;
+    float r = kerr_radius(metric_data, p);
+    float r2 = r * r;
+    float u = clamp(p.z / r, -1.0f, 1.0f);
+    float sin_theta = sqrt(max(1.0f - u * u, 1e-12f));
+    float sigma = r2 + a * a * u * u;
+    
+    // x + iy = (r + ia) sin θ e^{iφ}
+    float phi = atan2(p.y, p.x) - atan2(a, r);
+    float cos_phi = cos(phi), sin_phi = sin(phi);
+    
+    // ∂_t and ∂_φ are Killing vectors; ∂_θ is the same in both charts
+    float4 q = lower_index(metric_data, x, v);
+    float E = -q.x;
+    float L = p.x * q.z - p.y * q.y;
+    float3 d_theta = (float3)((r * cos_phi - a * sin_phi) * u,
+                              (r * sin_phi + a * cos_phi) * u,
+                              -r * sin_theta);
+    float p_theta = dot(q.yzw, d_theta);
+    
+    k->energy = E;
+    k->angular_momentum = L;
+    k->carter = p_theta * p_theta + u * u * (L * L / (sin_theta * sin_theta) - a * a * E * E);
+    
+    // dr and du from r⁴ - (ρ² - a²) r² - a²z² = 0 and u = z / r, times Σ
+    float3 w = v.yzw;
+    float dr = (r2 * dot(p, w) + a * a * p.z * w.z) / (r * (2.0f * r2 - dot(p, p) + a * a));
+    s->r = r;
+    s->dr = sigma * dr;
+    s->u = u;
+    s->du = sigma * (w.z - u * dr) / r;
+    s->phi = phi;
+    s->t = x.x;
+}
+
+// Back to Kerr-Schild Cartesian, with the velocity in affine parameter
+void kerr_to_cartesian(__constant float* metric_data, KerrState s, KerrConstants k, float4* x, float4* v) {
+    float a = KERR_SPIN;
+    float sin_theta = sqrt(max(1.0f - s.u * s.u, 1e-12f));
+    float cos_phi = cos(s.phi), sin_phi = sin(s.phi);
+    float ex = s.r * cos_phi - a * sin_phi;
+    float ey = s.r * sin_phi + a * cos_phi;
+    *x = (float4)(s.t, ex * sin_theta, ey * sin_theta, s.r * s.u);
+    
+    KerrState d;
+    kerr_derivatives(metric_data, s, k, &d);
+    float d_sin = -s.u * d.u / sin_theta;
+    float sigma = s.r * s.r + a * a * s.u * s.u;
+    *v = (float4)(d.t,
+                  (d.r * cos_phi - ey * d.phi) * sin_theta + ex * d_sin,
+                  (d.r * sin_phi + ex * d.phi) * sin_theta + ey * d_sin,
+                  d.r * s.u + s.r * d.u) / sigma;
+}
+
+// Mino-time counterpart of trace_geodesic. A step spans an affine
+// step_size * max(r / M, 1), Δλ_M = that / Σ, so the nearly straight far
+// field costs a handful of steps.
+void trace_kerr_geodesic(__constant float* metric_data, float4* pos, float4* vel, uchar* ray_flags,
+                         TraceParams params, int max_steps) {
+    KerrState s;
+    KerrConstants k;
+    kerr_from_cartesian(metric_data, *pos, *vel, &s, &k);
+    
+    float r_capture = max(params.horizon_radius * KERR_HORIZON_MARGIN, 1e-3f);
+    for (int step = 0; step < max_steps; ++step) {
+        if (s.r > params.escape_radius) {
+            *ray_flags |= RAY_TERMINATED;
+            break;
+        }
+        if (s.r < r_capture) {
+            *ray_flags |= RAY_TERMINATED | RAY_CAPTURED;
+            break;
+        }
+        
+        float sigma = s.r * s.r + KERR_SPIN * KERR_SPIN * s.u * s.u;
+        float scale = max(s.r / KERR_MASS, 1.0f);
+        kerr_step(metric_data, &s, k, params.step_size * scale / sigma);
+    }
+    
+    kerr_to_cartesian(metric_data, s, k, pos, vel);
+}
+#endif
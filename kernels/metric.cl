@@ -0,0 +1,158 @@
+// Metric hooks and the tensor algebra built on them
+#include "common.cl"
+
+// Metric hooks. Components are row-major:
+//   g[a * 4 + b]            = g_ab(x)
+//   dg[c * 16 + a * 4 + b]  = ∂_c g_ab(x)
+//   gamma[m * 16 + a * 4 + b] = Γ^m_ab(x)
+// metric_data is filled by the host:
+//   [0..3] origin x0, [4..19] g_ab(x0), [20..83] ∂_c g_ab(x0), the metric
+//   about the observer
+//   [84..] the plugin's parameters, in Config order
+#define METRIC_DATA_ORIGIN 0
+#define METRIC_DATA_G 4
+#define METRIC_DATA_DG 20
+#define METRIC_DATA_PARAMS 84
+
+// Metrics that supply device code (IMetric::getKernelSource) are spliced in
+// at the marker below and build with METRIC_SOURCE defined. They provide
+// metric_at() and metric_derivatives_at(), or metric_at() and christoffel_at()
+// with METRIC_HAS_CHRISTOFFEL defined. Each parameter is readable as
+// PARAM_<NAME>, which expands to its metric_data slot, or to a literal for
+// parameters the plugin declares structural.
+#ifdef METRIC_SOURCE
+// @METRIC_SOURCE@
+#else
+// The default hooks use the first-order expansion about the observer: the
+// connection is frozen at its value there, so for a curved metric rays are
+// only accurate close to the camera and drift further off the longer they
+// are traced. Metrics meant to be traced exactly must supply device code.
+
+void metric_at(__constant float* metric_data, float4 x, float g[16]) {
+    float4 d = x - vload4(0, metric_data + METRIC_DATA_ORIGIN);
+    __constant float* g0 = metric_data + METRIC_DATA_G;
+    __constant float* dg0 = metric_data + METRIC_DATA_DG;
+    for (int i = 0; i < 16; ++i) {
+        g[i] = g0[i] + dg0[i] * d.x + dg0[16 + i] * d.y + dg0[32 + i] * d.z + dg0[48 + i] * d.w;
+    }
+}
+
+void metric_derivatives_at(__constant float* metric_data, float4 x, float dg[64]) {
+    __constant float* dg0 = metric_data + METRIC_DATA_DG;
+    for (int i = 0; i < 64; ++i) {
+        dg[i] = dg0[i];
+    }
+}
+#endif
+
+// Inverse of a 4x4 matrix by cofactor expansion
+void invert_metric(const float m[16], float inv[16]) {
+    inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8]  =  m[4] * m[9]  * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9]  * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9]  = -m[0] * m[9]  * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] =  m[0] * m[9]  * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2]  =  m[1] * m[6]  * m[15] - m[1] * m[7]  * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7]  - m[13] * m[3] * m[6];
+    inv[6]  = -m[0] * m[6]  * m[15] + m[0] * m[7]  * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7]  + m[12] * m[3] * m[6];
+    inv[10] =  m[0] * m[5]  * m[15] - m[0] * m[7]  * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7]  - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5]  * m[14] + m[0] * m[6]  * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6]  + m[12] * m[2] * m[5];
+    inv[3]  = -m[1] * m[6]  * m[11] + m[1] * m[7]  * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9]  * m[2] * m[7]  + m[9]  * m[3] * m[6];
+    inv[7]  =  m[0] * m[6]  * m[11] - m[0] * m[7]  * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8]  * m[2] * m[7]  - m[8]  * m[3] * m[6];
+    inv[11] = -m[0] * m[5]  * m[11] + m[0] * m[7]  * m[9]  + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]  - m[8]  * m[1] * m[7]  + m[8]  * m[3] * m[5];
+    inv[15] =  m[0] * m[5]  * m[10] - m[0] * m[6]  * m[9]  - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]  + m[8]  * m[1] * m[6]  - m[8]  * m[2] * m[5];
+    
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    float inv_det = 1.0f / det;
+    for (int i = 0; i < 16; ++i) {
+        inv[i] *= inv_det;
+    }
+}
+
+// Index lowering and raising with the metric at x
+inline float4 lower_index(__constant float* metric_data, float4 x, float4 v) {
+    float g[16];
+    metric_at(metric_data, x, g);
+    return (float4)(g[0]  * v.x + g[1]  * v.y + g[2]  * v.z + g[3]  * v.w,
+                    g[4]  * v.x + g[5]  * v.y + g[6]  * v.z + g[7]  * v.w,
+                    g[8]  * v.x + g[9]  * v.y + g[10] * v.z + g[11] * v.w,
+                    g[12] * v.x + g[13] * v.y + g[14] * v.z + g[15] * v.w);
+}
+
+inline float4 raise_index(__constant float* metric_data, float4 x, float4 p) {
+    float g[16], g_inv[16];
+    metric_at(metric_data, x, g);
+    invert_metric(g, g_inv);
+    return (float4)(g_inv[0]  * p.x + g_inv[1]  * p.y + g_inv[2]  * p.z + g_inv[3]  * p.w,
+                    g_inv[4]  * p.x + g_inv[5]  * p.y + g_inv[6]  * p.z + g_inv[7]  * p.w,
+                    g_inv[8]  * p.x + g_inv[9]  * p.y + g_inv[10] * p.z + g_inv[11] * p.w,
+                    g_inv[12] * p.x + g_inv[13] * p.y + g_inv[14] * p.z + g_inv[15] * p.w);
+}
+
+// Geodesic equation: d²x^μ/dλ² = -Γ^μ_αβ v^α v^β with
+//   Γ^μ_αβ = ½ g^μν (∂_α g_νβ + ∂_β g_να - ∂_ν g_αβ)
+// Without supplied symbols they are contracted with v as they are formed,
+// which needs the 64 metric derivatives once instead of all 64 symbols.
+float4 geodesic_acceleration(__constant float* metric_data, float4 x, float4 v) {
+    float u[4] = { v.x, v.y, v.z, v.w };
+    float acc[4];
+    
+#ifdef METRIC_HAS_CHRISTOFFEL
+    float gamma[64];
+    christoffel_at(metric_data, x, gamma);
+    
+    for (int mu = 0; mu < 4; ++mu) {
+        float sum = 0.0f;
+        for (int a = 0; a < 4; ++a) {
+            for (int b = 0; b < 4; ++b) {
+                sum += gamma[mu * 16 + a * 4 + b] * u[a] * u[b];
+            }
+        }
+        acc[mu] = -sum;
+    }
+#else
+    float g[16], g_inv[16], dg[64];
+    metric_at(metric_data, x, g);
+    metric_derivatives_at(metric_data, x, dg);
+    invert_metric(g, g_inv);
+    
+    // Lowered contraction Γ_ναβ v^α v^β = ∂_α g_νβ v^α v^β - ½ ∂_ν g_αβ v^α v^β
+    float lowered[4];
+    for (int nu = 0; nu < 4; ++nu) {
+        float transport = 0.0f;
+        float gradient = 0.0f;
+        for (int a = 0; a < 4; ++a) {
+            for (int b = 0; b < 4; ++b) {
+                float uu = u[a] * u[b];
+                transport += dg[a * 16 + nu * 4 + b] * uu;
+                gradient += dg[nu * 16 + a * 4 + b] * uu;
+            }
+        }
+        lowered[nu] = transport - 0.5f * gradient;
+    }
+    
+    for (int mu = 0; mu < 4; ++mu) {
+        acc[mu] = -(g_inv[mu * 4 + 0] * lowered[0] + g_inv[mu * 4 + 1] * lowered[1] +
+                    g_inv[mu * 4 + 2] * lowered[2] + g_inv[mu * 4 + 3] * lowered[3]);
+    }
+#endif
+    return (float4)(acc[0], acc[1], acc[2], acc[3]);
+}
+
+// Future-directed null vector with spatial part dir: solves g_μν v^μ v^ν = 0 for v^t
+float4 make_null_velocity(__constant float* metric_data, float4 x, float3 dir) {
+    float g[16];
+    metric_at(metric_data, x, g);
+    
+    float a = min(g[0], -1e-6f);
+    float b = 2.0f * (g[1] * dir.x + g[2] * dir.y + g[3] * dir.z);
+    float c = g[5]  * dir.x * dir.x + g[10] * dir.y * dir.y + g[15] * dir.z * dir.z +
+              2.0f * (g[6] * dir.x * dir.y + g[7] * dir.x * dir.z + g[11] * dir.y * dir.z);
+    float discriminant = sqrt(max(b * b - 4.0f * a * c, 0.0f));
+    
+    // a < 0, so this is the positive root
+    float vt = (-b - discriminant) / (2.0f * a);
+    return (float4)(vt, dir);
+}
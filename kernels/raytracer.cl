@@ -1,142 +1,156 @@
-// Ray struct with standard alignment
-typedef struct {
-    float4 pos;      // Current position (t, x, y, z)
-    float4 vel;      // Current velocity (dt/dλ, dx/dλ, dy/dλ, dz/dλ)
-    int terminated;  // A flag to stop tracing
-    int sx, sy;      // Screen pixel coordinates
-    int padding1, padding2; // Padding for memory alignment
-} Ray;
+// Ray tracer program. Modules are composed with #include "<file>.cl",
+// resolved in memory from the embedded kernel table with each file included
+// once (see Graphics/KernelSource.h).
+#include "common.cl"
+#include "metric.cl"
+#include "camera.cl"
+#include "tracing.cl"
+#include "shading.cl"
 
-// Standard math constants
-#define PI_F 3.14159265358979323846f
-
-// Get the metric tensor diagonal components
-inline float4 get_metric_diagonal(float4 pos) {
-    return (float4)(METRIC_G00, METRIC_G11, METRIC_G22, METRIC_G33);
-}
-
-// Standard color computation
-float3 compute_color(Ray ray, float4 metric_diag) {
-    float3 color = (float3)(0.0f, 0.0f, 0.0f);
-    
-    // Get normalized direction using standard normalize
-    float3 dir = normalize(ray.vel.yzw);
-    
-    // Create a gradient based on ray direction and metric
-    float metric_factor = (metric_diag.x + metric_diag.y + metric_diag.z + metric_diag.w) * 0.25f;
-    
-    // Base color from direction
-    color.x = 0.5f + 0.5f * dir.x;
-    color.y = 0.5f + 0.5f * dir.y;  
-    color.z = 0.7f + 0.3f * dir.z;
+// Build the initial ray for every pixel from the camera block
+__kernel __attribute__((reqd_work_group_size(TILE_WIDTH, TILE_HEIGHT, 1)))
+void generate_rays(
+    __global float4* positions,
+    __global float4* velocities,
+    __global uchar* flags,
+    __global float* step_sizes,
+    Camera camera,
+    __constant float* metric_data,
+    float initial_step,
+    float capture_mass
+) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int id = ray_index(x, y, camera.width);
     
-    // Modulate by metric
-    color *= (0.8f + 0.2f * metric_factor);
+    // Rays of partial tiles outside the image never trace
+    if (x >= camera.width || y >= camera.height) {
+        flags[id] = RAY_TERMINATED;
+        return;
+    }
     
-    // Add grid lines using standard functions
-    float2 grid_coord = ray.vel.yz * 10.0f;
-    float grid_lines = 0.0f;
+    float3 dir = camera_ray_direction(camera, x, y);
+    float4 vel = make_null_velocity(metric_data, camera.position, dir);
     
-    // Use standard floor function instead of fmod/fract
-    float2 grid_floor = floor(grid_coord);
-    float2 grid_frac = grid_coord - grid_floor;
+    // Rays certain to fall into a spherically symmetric hole skip integration
+    uchar ray_flags = 0;
+    if (capture_mass > 0.0f && ray_is_captured(metric_data, camera.position, vel, capture_mass)) {
+        ray_flags = RAY_TERMINATED | RAY_CAPTURED;
+    }
     
-    if (grid_frac.x > 0.95f || grid_frac.y > 0.95f) {
-        grid_lines = 0.3f;
+    positions[id] = camera.position;
+    velocities[id] = vel;
+    flags[id] = ray_flags;
+    step_sizes[id] = initial_step;
+}
+
+// Main kernel using only standard OpenCL 3.0 features, one tile per work-group
+__kernel __attribute__((reqd_work_group_size(TILE_WIDTH, TILE_HEIGHT, 1)))
+void trace_rays(
+    __global const float4* positions,
+    __global const float4* velocities,
+    __global const uchar* flags,
+    OUTPUT_TYPE output,
+    int width,
+    int height,
+    __constant float* metric_data,
+    TraceParams params
+) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if (x >= width || y >= height) {
+        return;
     }
     
-    color += (float3)(grid_lines, grid_lines, grid_lines);
+    int id = ray_index(x, y, width);
     
-    // Add time-based animation using standard sin
-    float time_factor = sin(ray.pos.x * 0.1f) * 0.1f + 1.0f;
-    color *= time_factor;
+    float4 pos = positions[id];
+    float4 vel = velocities[id];
+    uchar ray_flags = flags[id];
+    float h = params.step_size;
     
-    // Enhanced visualization for different metrics
-    if (metric_diag.x < -0.5f) {
-        float dot_product = dot(dir, dir);
-        float gamma_factor = 1.0f / sqrt(max(0.1f, 1.0f - dot_product * 0.1f));
-        color *= (1.0f + 0.1f * gamma_factor);
+    if (!(ray_flags & RAY_TERMINATED)) {
+        trace_geodesic(metric_data, &pos, &vel, &h, &ray_flags, params, params.max_steps);
     }
     
-    // Clamp to valid range
-    color = clamp(color, 0.0f, 1.0f);
-    
-    return color;
+    // Write result
+    int2 coords = (int2)(x, y);
+    store_pixel(output, y * width + x, coords, shade_ray(metric_data, pos, vel, ray_flags));
 }
 
-// Standard ray integration
-void integrate_ray_step(Ray* ray, float4 metric_diag, float step_size) {
-    // Simple forward integration
-    ray->pos += ray->vel * step_size;
+// Progressive mode: advances unfinished rays by up to `steps` steps in place
+// and counts the rays still live, so the host knows when the image is final
+__kernel __attribute__((reqd_work_group_size(TILE_WIDTH, TILE_HEIGHT, 1)))
+void advance_rays(
+    __global float4* positions,
+    __global float4* velocities,
+    __global uchar* flags,
+    __global float* step_sizes,
+    int width,
+    int height,
+    __constant float* metric_data,
+    TraceParams params,
+    int steps,
+    __global int* live_count
+) {
+    __local int group_live;
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    bool first = (get_local_id(0) == 0 && get_local_id(1) == 0);
     
-    // Add curvature effects for non-Minkowski metrics
-    if (metric_diag.x != -1.0f || metric_diag.y != 1.0f) {
-        float3 pos_3d = ray->pos.yzw;
-        float r = length(pos_3d);
-        if (r > 0.1f) {
-            float3 normalized_pos = pos_3d / r;
-            float3 accel = -normalized_pos * (0.001f / (r * r));
-            ray->vel.yzw += accel * step_size;
-        }
+    if (first) {
+        group_live = 0;
     }
-}
-
-// Standard termination check
-bool should_terminate_ray(Ray ray) {
-    float distance = length(ray.pos.yzw);
-    if (distance > 100.0f) {
-        return true;
-    }
-    
-    float schwarzschild_radius = 2.0f;
-    if (distance < schwarzschild_radius) {
-        return true;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    if (x < width && y < height) {
+        int id = ray_index(x, y, width);
+        uchar ray_flags = flags[id];
+        if (!(ray_flags & RAY_TERMINATED)) {
+            float4 pos = positions[id];
+            float4 vel = velocities[id];
+            float h = step_sizes[id];
+            
+            trace_geodesic(metric_data, &pos, &vel, &h, &ray_flags, params, steps);
+            
+            positions[id] = pos;
+            velocities[id] = vel;
+            flags[id] = ray_flags;
+            step_sizes[id] = h;
+            if (!(ray_flags & RAY_TERMINATED)) {
+                atomic_inc(&group_live);
+            }
+        }
     }
     
-    float vel_magnitude = length(ray.vel);
-    if (vel_magnitude < 0.001f) {
-        return true;
+    // One global atomic per work-group
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (first && group_live > 0) {
+        atomic_add(live_count, group_live);
     }
-    
-    return false;
 }
 
-// Main kernel using only standard OpenCL 3.0 features
-__kernel void trace_rays(
-    __global Ray* rays,
-    __write_only image2d_t outputImage
+// Writes the image from the traced ray state
+__kernel __attribute__((reqd_work_group_size(TILE_WIDTH, TILE_HEIGHT, 1)))
+void shade_rays(
+    __global const float4* positions,
+    __global const float4* velocities,
+    __global const uchar* flags,
+    OUTPUT_TYPE output,
+    int width,
+    int height,
+    __constant float* metric_data
 ) {
-    int id = get_global_id(0);
-    int total_pixels = get_global_size(0);
-    
-    if (id >= total_pixels) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if (x >= width || y >= height) {
         return;
     }
     
-    Ray ray = rays[id];
-    float4 metric_diag = get_metric_diagonal(ray.pos);
-    
-    // Ray tracing loop with reasonable complexity
-    const int max_steps = 12;
-    const float step_size = 0.1f;
-    
-    for (int step = 0; step < max_steps && !ray.terminated; ++step) {
-        if (should_terminate_ray(ray)) {
-            ray.terminated = 1;
-            break;
-        }
-        
-        integrate_ray_step(&ray, metric_diag, step_size);
-        metric_diag = get_metric_diagonal(ray.pos);
-    }
-    
-    // Compute final color
-    float3 color = compute_color(ray, metric_diag);
-    
-    // Standard gamma correction using pow
-    color = pow(color, 1.0f / 2.2f);
-    
-    // Write result
-    int2 coords = (int2)(ray.sx, ray.sy);
-    write_imagef(outputImage, coords, (float4)(color, 1.0f));
-}
\ No newline at end of file
+    int id = ray_index(x, y, width);
+    int2 coords = (int2)(x, y);
+    store_pixel(output, y * width + x, coords, shade_ray(metric_data, positions[id], velocities[id], flags[id]));
+}
+
+#include "wavefront.cl"
+#include "transfer.cl"
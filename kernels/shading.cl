@@ -0,0 +1,70 @@
+// Ray colors and the final gamma-corrected output
+#include "metric.cl"
+
+// Standard color computation
+float3 compute_color(float4 pos, float4 vel, float4 metric_diag) {
+    float3 color = (float3)(0.0f, 0.0f, 0.0f);
+    
+    // Get normalized direction using standard normalize
+    float3 dir = normalize(vel.yzw);
+    
+    // Create a gradient based on ray direction and metric
+    float metric_factor = (metric_diag.x + metric_diag.y + metric_diag.z + metric_diag.w) * 0.25f;
+    
+    // Base color from direction
+    color.x = 0.5f + 0.5f * dir.x;
+    color.y = 0.5f + 0.5f * dir.y;  
+    color.z = 0.7f + 0.3f * dir.z;
+    
+    // Modulate by metric
+    color *= (0.8f + 0.2f * metric_factor);
+    
+    // Add grid lines using standard functions
+    float2 grid_coord = vel.yz * 10.0f;
+    float grid_lines = 0.0f;
+    
+    // Use standard floor function instead of fmod/fract
+    float2 grid_floor = floor(grid_coord);
+    float2 grid_frac = grid_coord - grid_floor;
+    
+    if (grid_frac.x > 0.95f || grid_frac.y > 0.95f) {
+        grid_lines = 0.3f;
+    }
+    
+    color += (float3)(grid_lines, grid_lines, grid_lines);
+    
+    // Add time-based animation using standard sin
+    float time_factor = sin(pos.x * 0.1f) * 0.1f + 1.0f;
+    color *= time_factor;
+    
+    // Enhanced visualization for different metrics
+    if (metric_diag.x < -0.5f) {
+        float dot_product = dot(dir, dir);
+        float gamma_factor = 1.0f / sqrt(max(0.1f, 1.0f - dot_product * 0.1f));
+        color *= (1.0f + 0.1f * gamma_factor);
+    }
+    
+    // Clamp to valid range
+    color = clamp(color, 0.0f, 1.0f);
+    
+    return color;
+}
+
+// Final, gamma-corrected color of a traced ray
+float4 shade_ray(__constant float* metric_data, float4 pos, float4 vel, uchar ray_flags) {
+    if (ray_flags & RAY_CAPTURED) {
+        return (float4)(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    
+    float g[16];
+    metric_at(metric_data, pos, g);
+    float4 metric_diag = (float4)(g[0], g[5], g[10], g[15]);
+    
+    // Compute final color
+    float3 color = compute_color(pos, vel, metric_diag);
+    
+    // Standard gamma correction using pow
+    color = pow(color, 1.0f / 2.2f);
+    
+    return (float4)(color, 1.0f);
+}
@@ -0,0 +1,82 @@
+// Ray termination, tracing loop and the analytic capture test
+#include "integrators.cl"
+#include "kerr.cl"
+
+// Standard termination check
+bool should_terminate_ray(float4 pos, float4 vel, TraceParams params, uchar* ray_flags) {
+    float distance = length(pos.yzw);
+    if (distance > params.escape_radius) {
+        return true;
+    }
+    
+    if (distance < params.horizon_radius) {
+        *ray_flags |= RAY_CAPTURED;
+        return true;
+    }
+    
+    float vel_magnitude = length(vel);
+    if (vel_magnitude < 0.001f) {
+        return true;
+    }
+    
+    return false;
+}
+
+// Advances a ray by up to max_steps integration steps. *h carries the
+// adaptive step size between calls.
+void trace_geodesic(__constant float* metric_data, float4* pos, float4* vel, float* h, uchar* ray_flags,
+                    TraceParams params, int max_steps) {
+#ifdef KERR_MINO
+    // Kerr rays are stepped in Mino time from their constants of motion; h is unused
+    trace_kerr_geodesic(metric_data, pos, vel, ray_flags, params, max_steps);
+#else
+#if defined(INTEGRATOR_DOPRI5)
+    float4 acc = geodesic_acceleration(metric_data, *pos, *vel);
+#elif defined(INTEGRATOR_SYMPLECTIC)
+    float4 mom = lower_index(metric_data, *pos, *vel);
+#endif
+    
+    for (int step = 0; step < max_steps; ++step) {
+        if (should_terminate_ray(*pos, *vel, params, ray_flags)) {
+            *ray_flags |= RAY_TERMINATED;
+            break;
+        }
+        
+#if defined(INTEGRATOR_DOPRI5)
+        dopri5_step(metric_data, pos, vel, &acc, h, params);
+#elif defined(INTEGRATOR_SYMPLECTIC)
+        symplectic_step(metric_data, pos, &mom, params.step_size);
+#else
+        integrate_ray_step(metric_data, pos, vel, params.step_size);
+#endif
+    }
+    
+#ifdef INTEGRATOR_SYMPLECTIC
+    *vel = raise_index(metric_data, *pos, mom);
+#endif
+#endif
+}
+
+// Analytic capture test for static, spherically symmetric metrics of mass M.
+// A photon moving inward from outside the photon sphere (r = 3M) falls in
+// when its impact parameter b = L/E is below 3√3 M; inside the photon
+// sphere every ingoing photon does.
+bool ray_is_captured(__constant float* metric_data, float4 x, float4 v, float mass) {
+    float3 r_vec = x.yzw;
+    float r = length(r_vec);
+    if (r <= 2.0f * mass || dot(r_vec, v.yzw) >= 0.0f) {
+        return false; // Inside the horizon or moving outward
+    }
+    if (r <= 3.0f * mass) {
+        return true;
+    }
+    
+    // E = -p_t and L = |x × p|, conserved by the symmetries
+    float4 p = lower_index(metric_data, x, v);
+    float energy = -p.x;
+    if (energy <= 0.0f) {
+        return false;
+    }
+    float b = length(cross(r_vec, p.yzw)) / energy;
+    return b < 3.0f * sqrt(3.0f) * mass * (1.0f - CAPTURE_MARGIN);
+}
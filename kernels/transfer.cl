@@ -0,0 +1,102 @@
+// Transfer table for spherically symmetric metrics
+#include "tracing.cl"
+#include "shading.cl"
+
+// In a spherically symmetric spacetime a ray's fate depends only on the
+// observer radius r and the angle α between the ray and the outward radial
+// direction. Per (α, r) the table holds the escape direction as an angle ψ
+// from the radial direction within the plane of the ray, the speed at escape
+// and whether the ray was captured:
+//   texel = (cos ψ, sin ψ, |v|, captured ? 1 : 0)
+// α spans [0, π] along x, r is log-spaced in [r_min, r_max] along y.
+
+__constant sampler_t transfer_sampler = CLK_NORMALIZED_COORDS_TRUE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+// Integrates one ray per texel, in the x-y plane from an observer on the x axis
+__kernel void build_transfer_table(
+    __write_only image2d_t table,
+    int angles,
+    int radii,
+    float r_min,
+    float r_max,
+    __constant float* metric_data,
+    TraceParams params
+) {
+    int i = get_global_id(0);
+    int j = get_global_id(1);
+    if (i >= angles || j >= radii) {
+        return;
+    }
+    
+    float alpha = (i + 0.5f) / angles * PI_F;
+    float r = r_min * pow(r_max / r_min, (j + 0.5f) / radii);
+    
+    float4 pos = (float4)(0.0f, r, 0.0f, 0.0f);
+    float4 vel = make_null_velocity(metric_data, pos, (float3)(cos(alpha), sin(alpha), 0.0f));
+    float h = params.step_size;
+    uchar ray_flags = 0;
+    trace_geodesic(metric_data, &pos, &vel, &h, &ray_flags, params, params.max_steps);
+    
+    // Rays out of steps are taken in their current direction
+    float4 texel = (float4)(1.0f, 0.0f, 0.0f, 1.0f);
+    if (!(ray_flags & RAY_CAPTURED)) {
+        float speed = length(vel.yzw);
+        texel = (float4)(vel.y / speed, vel.z / speed, speed, 0.0f);
+    }
+    write_imagef(table, (int2)(i, j), texel);
+}
+
+// Lookup render mode: shades every pixel from the table instead of integrating
+__kernel __attribute__((reqd_work_group_size(TILE_WIDTH, TILE_HEIGHT, 1)))
+void lookup_rays(
+    OUTPUT_TYPE output,
+    int width,
+    int height,
+    Camera camera,
+    __constant float* metric_data,
+    __read_only image2d_t table,
+    float r_min,
+    float r_max,
+    float escape_radius
+) {
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if (x >= width || y >= height) {
+        return;
+    }
+    
+    float3 dir = camera_ray_direction(camera, x, y);
+    float3 r_vec = camera.position.yzw;
+    float r0 = max(length(r_vec), 1e-6f);
+    float3 radial = r_vec / r0;
+    
+    // Plane of the ray: the radial direction and the tangent towards dir
+    float cos_alpha = clamp(dot(dir, radial), -1.0f, 1.0f);
+    float3 tangent = dir - cos_alpha * radial;
+    float tangent_length = length(tangent);
+    if (tangent_length > 1e-6f) {
+        tangent /= tangent_length;
+    } else {
+        // Radial ray, any perpendicular will do
+        float3 axis = (fabs(radial.x) < 0.9f) ? (float3)(1.0f, 0.0f, 0.0f) : (float3)(0.0f, 1.0f, 0.0f);
+        tangent = normalize(cross(radial, axis));
+    }
+    
+    float2 coords = (float2)(acos(cos_alpha) / PI_F, log(r0 / r_min) / log(r_max / r_min));
+    float4 texel = read_imagef(table, transfer_sampler, coords);
+    
+    float4 color;
+    if (texel.w > 0.5f) {
+        color = shade_ray(metric_data, camera.position, (float4)(0.0f), RAY_TERMINATED | RAY_CAPTURED);
+    } else {
+        float2 psi = normalize(texel.xy);
+        float3 d = psi.x * radial + psi.y * tangent;
+        
+        // Reconstructed escape point, with a flat-space estimate of the time
+        float4 pos = (float4)(camera.position.x + escape_radius - r0, escape_radius * d);
+        float4 vel = (float4)(texel.z, texel.z * d);
+        color = shade_ray(metric_data, pos, vel, RAY_TERMINATED);
+    }
+    
+    store_pixel(output, y * width + x, (int2)(x, y), color);
+}
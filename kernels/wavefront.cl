@@ -0,0 +1,165 @@
+// Wavefront mode: tracing in rounds and compaction of the live rays
+#include "tracing.cl"
+
+// Exclusive prefix sum of data[0..SCAN_BLOCK_SIZE) in local memory (Blelloch).
+// SCAN_BLOCK_SIZE must be a power of two.
+void local_exclusive_scan(__local int* data, int lid) {
+    for (int stride = 1; stride < SCAN_BLOCK_SIZE; stride <<= 1) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        int i = (lid + 1) * stride * 2 - 1;
+        if (i < SCAN_BLOCK_SIZE) {
+            data[i] += data[i - stride];
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid == 0) {
+        data[SCAN_BLOCK_SIZE - 1] = 0;
+    }
+    for (int stride = SCAN_BLOCK_SIZE / 2; stride > 0; stride >>= 1) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        int i = (lid + 1) * stride * 2 - 1;
+        if (i < SCAN_BLOCK_SIZE) {
+            int t = data[i - stride];
+            data[i - stride] = data[i];
+            data[i] += t;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+// Every ray starts active. Active counts stay on the device, so rounds are
+// enqueued without reading them back; dispatches are sized by an upper bound.
+__kernel void init_active_rays(
+    __global int* active,
+    __global int* active_count,
+    int count
+) {
+    int i = get_global_id(0);
+    if (i == 0) {
+        *active_count = count;
+    }
+    if (i >= count) {
+        return;
+    }
+    active[i] = i;
+}
+
+// Advances every active ray by up to steps_per_round steps, in place
+__kernel void trace_wavefront(
+    __global float4* positions,
+    __global float4* velocities,
+    __global uchar* flags,
+    __global float* step_sizes,
+    __global const int* active,
+    __global const int* active_count,
+    __constant float* metric_data,
+    TraceParams params,
+    int steps_per_round
+) {
+    int i = get_global_id(0);
+    if (i >= *active_count) {
+        return;
+    }
+    
+    int id = active[i];
+    uchar ray_flags = flags[id];
+    if (ray_flags & RAY_TERMINATED) {
+        return; // Padding rays on the first round
+    }
+    
+    float4 pos = positions[id];
+    float4 vel = velocities[id];
+    float h = step_sizes[id];
+    
+    trace_geodesic(metric_data, &pos, &vel, &h, &ray_flags, params, steps_per_round);
+    
+    positions[id] = pos;
+    velocities[id] = vel;
+    flags[id] = ray_flags;
+    step_sizes[id] = h;
+}
+
+// Compaction, pass 1: offset of each live ray within its block, and the
+// number of live rays per block
+__kernel __attribute__((reqd_work_group_size(SCAN_BLOCK_SIZE, 1, 1)))
+void scan_active_rays(
+    __global const int* active,
+    __global const int* active_count_buffer,
+    __global const uchar* flags,
+    __global int* offsets,
+    __global int* block_sums
+) {
+    __local int scan[SCAN_BLOCK_SIZE];
+    int i = get_global_id(0);
+    int lid = get_local_id(0);
+    int active_count = *active_count_buffer;
+    
+    int alive = (i < active_count && !(flags[active[i]] & RAY_TERMINATED)) ? 1 : 0;
+    scan[lid] = alive;
+    local_exclusive_scan(scan, lid);
+    
+    if (i < active_count) {
+        offsets[i] = scan[lid];
+    }
+    if (lid == SCAN_BLOCK_SIZE - 1) {
+        block_sums[get_group_id(0)] = scan[lid] + alive;
+    }
+}
+
+// Compaction, pass 2: exclusive scan of the block sums by a single
+// work-group, and the total number of live rays, the next active count
+__kernel __attribute__((reqd_work_group_size(SCAN_BLOCK_SIZE, 1, 1)))
+void scan_block_sums(
+    __global int* block_sums,
+    __global const int* active_count,
+    __global int* live_count
+) {
+    __local int scan[SCAN_BLOCK_SIZE];
+    __local int chunk_total;
+    int lid = get_local_id(0);
+    int block_count = (*active_count + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE;
+    int carry = 0;
+    
+    for (int base = 0; base < block_count; base += SCAN_BLOCK_SIZE) {
+        int i = base + lid;
+        int value = (i < block_count) ? block_sums[i] : 0;
+        scan[lid] = value;
+        local_exclusive_scan(scan, lid);
+        
+        if (i < block_count) {
+            block_sums[i] = carry + scan[lid];
+        }
+        if (lid == SCAN_BLOCK_SIZE - 1) {
+            chunk_total = scan[lid] + value;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        carry += chunk_total;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    
+    if (lid == 0) {
+        *live_count = carry;
+    }
+}
+
+// Compaction, pass 3: scatter live rays to the next active list, keeping
+// their order
+__kernel __attribute__((reqd_work_group_size(SCAN_BLOCK_SIZE, 1, 1)))
+void compact_active_rays(
+    __global const int* active,
+    __global const int* active_count,
+    __global const uchar* flags,
+    __global const int* offsets,
+    __global const int* block_sums,
+    __global int* next_active
+) {
+    int i = get_global_id(0);
+    if (i >= *active_count) {
+        return;
+    }
+    
+    int id = active[i];
+    if (!(flags[id] & RAY_TERMINATED)) {
+        next_active[block_sums[get_group_id(0)] + offsets[i]] = id;
+    }
+}
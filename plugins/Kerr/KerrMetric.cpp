@@ -0,0 +1,175 @@
+#include "KerrMetric.h"
+#include <algorithm>
+#include <cmath>
+
+// The functions that the PluginManager will use to create/destroy instances
+extern "C" IMetric* createMetric() {
+    return new KerrMetric();
+}
+
+extern "C" void destroyMetric(IMetric* metric) {
+    delete metric;
+}
+
+// Kerr-Schild metric for T = double or Dual<double>; with duals seeded on one
+// coordinate the dual parts are the derivatives along it
+template<typename T>
+static void kerrSchild(const T x[4], double mass, double spin, T g[4][4]) {
+    T M(mass), a(spin), a2(spin * spin);
+    T one(1.0), two(2.0), half(0.5), quarter(0.25);
+
+    T rho2 = x[1] * x[1] + x[2] * x[2] + x[3] * x[3];
+    T b = rho2 - a2;
+    T r2 = half * b + sqrt(quarter * b * b + a2 * x[3] * x[3]);
+    T r = sqrt(r2 + T(1e-12));
+    T f = two * M * r2 * r / (r2 * r2 + a2 * x[3] * x[3]);
+    T l[4] = {one, (r * x[1] + a * x[2]) / (r2 + a2), (r * x[2] - a * x[1]) / (r2 + a2), x[3] / r};
+
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            g[i][j] = f * l[i] * l[j];
+        }
+    }
+    g[0][0] = g[0][0] - one;
+    g[1][1] = g[1][1] + one;
+    g[2][2] = g[2][2] + one;
+    g[3][3] = g[3][3] + one;
+}
+
+KerrMetric::KerrMetric() {
+    m_Config["mass"] = {1.0, 0.1, 5.0};
+    m_Config["spin"] = {0.9, 0.0, 5.0};
+}
+
+void KerrMetric::applyParameter(const std::string& key, double value) {
+    auto it = m_Config.find(key);
+    if (it != m_Config.end()) {
+        it->second.value = std::clamp(value, it->second.min, it->second.max);
+    }
+}
+
+double KerrMetric::getSpin() const {
+    // a < M keeps the horizon
+    return std::min(m_Config.at("spin").value, 0.999 * getMass());
+}
+
+MetricTraits KerrMetric::getTraits() const {
+    double mass = getMass();
+    double spin = getSpin();
+
+    MetricTraits traits;
+    traits.mass = mass;
+    traits.spin = spin;
+    traits.horizonRadius = mass + std::sqrt(mass * mass - spin * spin);
+    traits.kerrSeparable = true;
+    return traits;
+}
+
+Tensor2D<4, 4> KerrMetric::getMetricTensor(const Vec4& position) const {
+    double x[4] = {position[0], position[1], position[2], position[3]};
+    double g[4][4];
+    kerrSchild(x, getMass(), getSpin(), g);
+
+    Tensor2D<4, 4> result{};
+    for (int a = 0; a < 4; ++a) {
+        for (int b = 0; b < 4; ++b) {
+            result[a][b] = g[a][b];
+        }
+    }
+    return result;
+}
+
+std::array<Tensor2D<4, 4>, 4> KerrMetric::getMetricDerivatives(const Vec4& position) const {
+    // Stationary: the t derivatives vanish
+    std::array<Tensor2D<4, 4>, 4> dg{};
+    for (int c = 1; c < 4; ++c) {
+        Dual<double> x[4];
+        for (int i = 0; i < 4; ++i) {
+            x[i] = Dual<double>(position[i], i == c ? 1.0 : 0.0);
+        }
+        Dual<double> g[4][4];
+        kerrSchild(x, getMass(), getSpin(), g);
+        for (int a = 0; a < 4; ++a) {
+            for (int b = 0; b < 4; ++b) {
+                dg[c][a][b] = g[a][b].dual;
+            }
+        }
+    }
+    return dg;
+}
+
+std::string KerrMetric::getKernelSource() const {
+    // Mass and spin are read at run time, so the source is fixed
+    return R"CLC(
+#define KERR_MASS PARAM_MASS
+#define KERR_SPIN min(PARAM_SPIN, 0.999f * PARAM_MASS) // Clamped as on the host
+
+// Boyer-Lindquist radius of a Kerr-Schild point
+inline float kerr_radius(__constant float* metric_data, float3 p) {
+    float a2 = KERR_SPIN * KERR_SPIN;
+    float b = dot(p, p) - a2;
+    float r2 = 0.5f * b + sqrt(0.25f * b * b + a2 * p.z * p.z);
+    return sqrt(max(r2, 1e-12f));
+}
+
+inline void metric_at(__constant float* metric_data, float4 x, float g[16]) {
+    float a = KERR_SPIN;
+    float r = kerr_radius(metric_data, x.yzw);
+    float r2 = r * r;
+    float f = 2.0f * KERR_MASS * r2 * r / (r2 * r2 + a * a * x.w * x.w);
+    float inv = 1.0f / (r2 + a * a);
+    float l[4] = { 1.0f, (r * x.y + a * x.z) * inv, (r * x.z - a * x.y) * inv, x.w / r };
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            g[i * 4 + j] = f * l[i] * l[j];
+        }
+    }
+    g[0] -= 1.0f;
+    g[5] += 1.0f;
+    g[10] += 1.0f;
+    g[15] += 1.0f;
+}
+
+inline void metric_derivatives_at(__constant float* metric_data, float4 x, float dg[64]) {
+    float a = KERR_SPIN;
+    float a2 = a * a;
+    float3 p = x.yzw;
+    float r = kerr_radius(metric_data, p);
+    float r2 = r * r;
+    float rho2 = dot(p, p);
+    
+    float denominator = r2 * r2 + a2 * p.z * p.z;
+    float f = 2.0f * KERR_MASS * r2 * r / denominator;
+    float inv = 1.0f / (r2 + a2);
+    float l[4] = { 1.0f, (r * p.x + a * p.y) * inv, (r * p.y - a * p.x) * inv, p.z / r };
+    
+    // ∂_i r from r⁴ - (ρ² - a²) r² - a²z² = 0
+    float d = r * (2.0f * r2 - rho2 + a2);
+    float3 dr = (float3)(r2 * p.x, r2 * p.y, (r2 + a2) * p.z) / d;
+    
+    for (int i = 0; i < 16; ++i) {
+        dg[i] = 0.0f;
+    }
+    for (int c = 0; c < 3; ++c) {
+        float dr_c = (c == 0) ? dr.x : ((c == 1) ? dr.y : dr.z);
+        float dx = (c == 0) ? 1.0f : 0.0f;
+        float dy = (c == 1) ? 1.0f : 0.0f;
+        float dz = (c == 2) ? 1.0f : 0.0f;
+        
+        float df = 2.0f * KERR_MASS * (3.0f * r2 * dr_c * denominator -
+                   r2 * r * (4.0f * r2 * r * dr_c + 2.0f * a2 * p.z * dz)) / (denominator * denominator);
+        float dl[4];
+        dl[0] = 0.0f;
+        dl[1] = ((dr_c * p.x + r * dx + a * dy) - l[1] * 2.0f * r * dr_c) * inv;
+        dl[2] = ((dr_c * p.y + r * dy - a * dx) - l[2] * 2.0f * r * dr_c) * inv;
+        dl[3] = (dz * r - p.z * dr_c) / r2;
+        
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                dg[(c + 1) * 16 + i * 4 + j] = df * l[i] * l[j] + f * (dl[i] * l[j] + l[i] * dl[j]);
+            }
+        }
+    }
+}
+)CLC";
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Physics/IMetric.h"
+
+// Rotating black hole of mass M and spin a (along z) in Kerr-Schild
+// Cartesian coordinates:
+//   g_ab = η_ab + f l_a l_b,  f = 2Mr³ / (r⁴ + a²z²)
+//   l = (1, (rx + ay) / (r² + a²), (ry - ax) / (r² + a²), z / r)
+// where r is the Boyer-Lindquist radius,
+//   r⁴ - (x² + y² + z² - a²) r² - a²z² = 0
+class KerrMetric : public IMetric {
+public:
+    KerrMetric();
+
+    const char* getName() const override { return "Kerr"; }
+    const char* getDescription() const override { return "Rotating black hole of mass M and spin a."; }
+
+    const Config& getParameters() const override { return m_Config; }
+    MetricTraits getTraits() const override;
+
+    Tensor2D<4, 4> getMetricTensor(const Vec4& position) const override;
+    std::array<Tensor2D<4, 4>, 4> getMetricDerivatives(const Vec4& position) const override;
+    std::string getKernelSource() const override;
+    bool hasKernelSource() const override { return true; }
+protected:
+    void applyParameter(const std::string& key, double value) override;
+private:
+    double getMass() const { return m_Config.at("mass").value; }
+    double getSpin() const; // Clamped below M
+
+    Config m_Config;
+};
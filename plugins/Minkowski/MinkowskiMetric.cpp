@@ -21,4 +21,28 @@ Tensor2D<4, 4> MinkowskiMetric::getMetricTensor(const Vec4& position) const {
 std::array<Tensor2D<4, 4>, 4> MinkowskiMetric::getMetricDerivatives(const Vec4& position) const {
     // Derivatives of a constant metric are all zero
     return std::array<Tensor2D<4, 4>, 4>{};
+}
+
+std::string MinkowskiMetric::getKernelSource() const {
+    // Constant metric, so every Christoffel symbol vanishes and the geodesic
+    // step folds down to a straight line
+    return R"CLC(
+#define METRIC_HAS_CHRISTOFFEL
+
+inline void metric_at(__constant float* metric_data, float4 x, float g[16]) {
+    for (int i = 0; i < 16; ++i) {
+        g[i] = 0.0f;
+    }
+    g[0] = -1.0f;
+    g[5] = 1.0f;
+    g[10] = 1.0f;
+    g[15] = 1.0f;
+}
+
+inline void christoffel_at(__constant float* metric_data, float4 x, float gamma[64]) {
+    for (int i = 0; i < 64; ++i) {
+        gamma[i] = 0.0f;
+    }
+}
+)CLC";
 }
\ No newline at end of file
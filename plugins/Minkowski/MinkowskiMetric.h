@@ -8,10 +8,13 @@ public:
     const char* getDescription() const override { return "Flat, empty spacetime."; }
 
     const Config& getParameters() const override { return m_Config; }
-    void setParameter(const std::string& key, double value) override { /* No parameters */ }
 
     Tensor2D<4, 4> getMetricTensor(const Vec4& position) const override;
     std::array<Tensor2D<4, 4>, 4> getMetricDerivatives(const Vec4& position) const override;
+    std::string getKernelSource() const override;
+    bool hasKernelSource() const override { return true; }
+protected:
+    void applyParameter(const std::string& key, double value) override { /* No parameters */ }
 private:
     Config m_Config;
 };
\ No newline at end of file
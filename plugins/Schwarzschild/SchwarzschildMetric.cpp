@@ -0,0 +1,120 @@
+#include "SchwarzschildMetric.h"
+#include <algorithm>
+#include <cmath>
+
+// The functions that the PluginManager will use to create/destroy instances
+extern "C" IMetric* createMetric() {
+    return new SchwarzschildMetric();
+}
+
+extern "C" void destroyMetric(IMetric* metric) {
+    delete metric;
+}
+
+SchwarzschildMetric::SchwarzschildMetric() {
+    m_Config["mass"] = {1.0, 0.1, 5.0};
+}
+
+void SchwarzschildMetric::applyParameter(const std::string& key, double value) {
+    auto it = m_Config.find(key);
+    if (it != m_Config.end()) {
+        it->second.value = std::clamp(value, it->second.min, it->second.max);
+    }
+}
+
+MetricTraits SchwarzschildMetric::getTraits() const {
+    MetricTraits traits;
+    traits.sphericallySymmetric = true;
+    traits.mass = getMass();
+    traits.horizonRadius = 2.0 * getMass();
+    return traits;
+}
+
+Tensor2D<4, 4> SchwarzschildMetric::getMetricTensor(const Vec4& position) const {
+    double x = position[1], y = position[2], z = position[3];
+    double r = std::max(std::sqrt(x * x + y * y + z * z), 1e-6);
+    double f = 2.0 * getMass() / r;
+    double l[4] = {1.0, x / r, y / r, z / r};
+
+    Tensor2D<4, 4> g{};
+    for (int a = 0; a < 4; ++a) {
+        for (int b = 0; b < 4; ++b) {
+            g[a][b] = f * l[a] * l[b];
+        }
+    }
+    g[0][0] = g[0][0].real - 1.0; // η_tt
+    g[1][1] = g[1][1].real + 1.0;
+    g[2][2] = g[2][2].real + 1.0;
+    g[3][3] = g[3][3].real + 1.0;
+    return g;
+}
+
+std::array<Tensor2D<4, 4>, 4> SchwarzschildMetric::getMetricDerivatives(const Vec4& position) const {
+    double x[3] = {position[1], position[2], position[3]};
+    double r = std::max(std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]), 1e-6);
+    double f = 2.0 * getMass() / r;
+    double n[3] = {x[0] / r, x[1] / r, x[2] / r};
+    double l[4] = {1.0, n[0], n[1], n[2]};
+
+    // Static: the t derivatives vanish
+    std::array<Tensor2D<4, 4>, 4> dg{};
+    for (int c = 0; c < 3; ++c) {
+        // ∂_c f = -2M x_c / r³, ∂_c l_j = (δ_cj - n_c n_j) / r
+        double df = -f * n[c] / r;
+        double dl[4] = {0.0, 0.0, 0.0, 0.0};
+        for (int j = 0; j < 3; ++j) {
+            dl[j + 1] = ((c == j ? 1.0 : 0.0) - n[c] * n[j]) / r;
+        }
+        for (int a = 0; a < 4; ++a) {
+            for (int b = 0; b < 4; ++b) {
+                dg[c + 1][a][b] = df * l[a] * l[b] + f * (dl[a] * l[b] + l[a] * dl[b]);
+            }
+        }
+    }
+    return dg;
+}
+
+std::string SchwarzschildMetric::getKernelSource() const {
+    // The mass is read at run time as PARAM_MASS, so the source is fixed
+    return R"CLC(
+inline void metric_at(__constant float* metric_data, float4 x, float g[16]) {
+    float r = max(length(x.yzw), 1e-6f);
+    float f = 2.0f * PARAM_MASS / r;
+    float l[4] = { 1.0f, x.y / r, x.z / r, x.w / r };
+    for (int a = 0; a < 4; ++a) {
+        for (int b = 0; b < 4; ++b) {
+            g[a * 4 + b] = f * l[a] * l[b];
+        }
+    }
+    g[0] -= 1.0f;
+    g[5] += 1.0f;
+    g[10] += 1.0f;
+    g[15] += 1.0f;
+}
+
+inline void metric_derivatives_at(__constant float* metric_data, float4 x, float dg[64]) {
+    float r = max(length(x.yzw), 1e-6f);
+    float inv_r = 1.0f / r;
+    float f = 2.0f * PARAM_MASS * inv_r;
+    float n[3] = { x.y * inv_r, x.z * inv_r, x.w * inv_r };
+    float l[4] = { 1.0f, n[0], n[1], n[2] };
+    
+    for (int i = 0; i < 16; ++i) {
+        dg[i] = 0.0f;
+    }
+    for (int c = 0; c < 3; ++c) {
+        float df = -f * n[c] * inv_r;
+        float dl[4];
+        dl[0] = 0.0f;
+        for (int j = 0; j < 3; ++j) {
+            dl[j + 1] = ((c == j ? 1.0f : 0.0f) - n[c] * n[j]) * inv_r;
+        }
+        for (int a = 0; a < 4; ++a) {
+            for (int b = 0; b < 4; ++b) {
+                dg[(c + 1) * 16 + a * 4 + b] = df * l[a] * l[b] + f * (dl[a] * l[b] + l[a] * dl[b]);
+            }
+        }
+    }
+}
+)CLC";
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Physics/IMetric.h"
+
+// Schwarzschild black hole in Kerr-Schild Cartesian coordinates:
+// g_ab = η_ab + (2M/r) l_a l_b with l = (1, x/r, y/r, z/r), regular across
+// the horizon at r = 2M
+class SchwarzschildMetric : public IMetric {
+public:
+    SchwarzschildMetric();
+
+    const char* getName() const override { return "Schwarzschild"; }
+    const char* getDescription() const override { return "Non-rotating black hole of mass M."; }
+
+    const Config& getParameters() const override { return m_Config; }
+    MetricTraits getTraits() const override;
+
+    Tensor2D<4, 4> getMetricTensor(const Vec4& position) const override;
+    std::array<Tensor2D<4, 4>, 4> getMetricDerivatives(const Vec4& position) const override;
+    std::string getKernelSource() const override;
+    bool hasKernelSource() const override { return true; }
+protected:
+    void applyParameter(const std::string& key, double value) override;
+private:
+    double getMass() const { return m_Config.at("mass").value; }
+
+    Config m_Config;
+};
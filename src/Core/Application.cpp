@@ -5,26 +5,88 @@
 #include "UI/UIManager.h"
 #include <glad/glad.h>  // Add this for OpenGL functions
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
 
-Application::Application() {
-    m_Window = std::make_unique<Window>(1280, 720, "Sirius");
+namespace {
+
+using StartupClock = std::chrono::steady_clock;
+
+double millisecondsSince(StartupClock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(StartupClock::now() - begin).count();
+}
+
+} // namespace
 
-    // Create the plugin manager and load plugins from the build output directory
+Application::Application() : m_StartupBegin(StartupClock::now()) {
+    // Plugin loading and OpenCL setup don't need the GL context, so they run
+    // on worker threads while the window comes up. Each phase records its
+    // own duration; the futures order those writes before the report.
+    double pluginsMs = 0.0, openclMs = 0.0, kernelStartMs = 0.0;
     m_PluginManager = std::make_unique<PluginManager>();
-    m_PluginManager->loadPlugins("./plugins"); // Assumes running from build dir
+    std::shared_future<void> pluginsReady = std::async(std::launch::async, [this, &pluginsMs]() {
+        auto begin = StartupClock::now();
+        m_PluginManager->loadPlugins("./plugins"); // Assumes running from build dir
 
-    // Set the initial metric if any were loaded
-    auto metricNames = m_PluginManager->getMetricNames();
-    if (!metricNames.empty()) {
-        m_CurrentMetricName = metricNames[0];
-        m_CurrentMetric = m_PluginManager->getMetric(m_CurrentMetricName);
-    }
+        // Set the initial metric if any were loaded
+        auto metricNames = m_PluginManager->getMetricNames();
+        if (!metricNames.empty()) {
+            m_CurrentMetricName = metricNames[0];
+            m_CurrentMetric = m_PluginManager->getMetric(m_CurrentMetricName);
+        }
+        pluginsMs = millisecondsSince(begin);
+    }).share();
+
+    std::future<std::unique_ptr<Renderer>> rendererReady = std::async(std::launch::async,
+        [this, pluginsReady, &openclMs, &kernelStartMs]() {
+            auto begin = StartupClock::now();
+            auto renderer = std::make_unique<Renderer>(1280, 720);
+            openclMs = millisecondsSince(begin);
+
+            // Build the default metric's kernel speculatively; the first
+            // frame picks it up instead of starting its own build
+            pluginsReady.get();
+            renderer->prebuildKernel(m_CurrentMetric);
+            kernelStartMs = millisecondsSince(m_StartupBegin);
+            return renderer;
+        });
+
+    auto begin = StartupClock::now();
+    m_Window = std::make_unique<Window>(1280, 720, "Sirius");
+    double windowMs = millisecondsSince(begin);
+
+    begin = StartupClock::now();
+    pluginsReady.get();
+    m_Renderer = rendererReady.get();
+    double waitMs = millisecondsSince(begin);
+
+    // Render targets include GL textures, so they are created here now that
+    // the context is current on this thread
+    begin = StartupClock::now();
+    m_Renderer->createResources();
+    double resourcesMs = millisecondsSince(begin);
 
-    // Create the renderer after OpenGL context is ready
-    m_Renderer = std::make_unique<Renderer>(1280, 720);
-    
     // UIManager now takes a reference to this Application instance
+    begin = StartupClock::now();
     m_UIManager = std::make_unique<UIManager>(m_Window->getNativeWindow(), *this);
+    double uiMs = millisecondsSince(begin);
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1)
+           << "Startup (ms):\n"
+           << "  Window and GL context:   " << windowMs << "\n"
+           << "  Plugins (worker):        " << pluginsMs << "\n"
+           << "  OpenCL setup (worker):   " << openclMs << "\n"
+           << "  Kernel build started at: " << kernelStartMs << "\n"
+           << "  Waiting on workers:      " << waitMs << "\n"
+           << "  Render targets:          " << resourcesMs << "\n"
+           << "  UI:                      " << uiMs << "\n"
+           << "  Total:                   " << millisecondsSince(m_StartupBegin);
+    std::cout << report.str() << std::endl;
 }
 
 Application::~Application() {}
@@ -35,12 +97,20 @@ void Application::run() {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        m_Window->pollEvents();
+        // Sleep until input arrives once the image is up to date; a few idle
+        // frames first give the UI time to settle after the last interaction
+        if (m_IdleFrames >= kIdleFramesBeforeWait) {
+            m_Window->waitEvents();
+        } else {
+            m_Window->pollEvents();
+        }
 
         // Render the scene using OpenCL if we have a metric
+        bool busy = false;
         if (m_CurrentMetric) {
-            m_Renderer->render(m_CurrentMetric);
+            busy = m_Renderer->render(m_CurrentMetric);
         }
+        m_IdleFrames = busy ? 0 : m_IdleFrames + 1;
 
         // Render the UI
         m_UIManager->beginFrame();
@@ -48,5 +118,12 @@ void Application::run() {
         m_UIManager->endFrame();
 
         m_Window->swapBuffers();
+
+        // The first traced image, not the placeholder shown while the kernel
+        // builds, is what startup is measured against
+        if (!m_FirstFrameReported && m_Renderer->hasPresentedFrame()) {
+            m_FirstFrameReported = true;
+            std::cout << "First frame after " << std::lround(millisecondsSince(m_StartupBegin)) << " ms" << std::endl;
+        }
     }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -29,5 +30,13 @@ private:
     IMetric* m_CurrentMetric = nullptr;
     std::string m_CurrentMetricName;
 
+    // Consecutive frames in which the renderer had nothing to do
+    int m_IdleFrames = 0;
+    static constexpr int kIdleFramesBeforeWait = 3;
+
+    // Time to the first traced frame is reported once it is on screen
+    std::chrono::steady_clock::time_point m_StartupBegin;
+    bool m_FirstFrameReported = false;
+
     friend class UIManager; // Allow UIManager to access Application's state
 };
\ No newline at end of file
@@ -57,6 +57,10 @@ void Window::pollEvents() const {
     glfwPollEvents();
 }
 
+void Window::waitEvents() const {
+    glfwWaitEvents();
+}
+
 void Window::swapBuffers() const {
     glfwSwapBuffers(m_Window);
 }
\ No newline at end of file
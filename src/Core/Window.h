@@ -12,6 +12,7 @@ public:
 
     bool shouldClose() const;
     void pollEvents() const;
+    void waitEvents() const;
     void swapBuffers() const;
 
     GLFWwindow* getNativeWindow() const { return m_Window; }
@@ -0,0 +1,167 @@
+#include "KernelSource.h"
+#include "Physics/IMetric.h"
+#include <stdexcept>
+#include <sstream>
+#include <iterator>
+#include <string_view>
+#include <set>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+static std::string_view findEmbeddedKernel(const std::string& name) {
+    for (size_t i = 0; i < kEmbeddedKernelCount; ++i) {
+        if (name == kEmbeddedKernels[i].name) {
+            return std::string_view(reinterpret_cast<const char*>(kEmbeddedKernels[i].data), kEmbeddedKernels[i].size);
+        }
+    }
+    throw std::runtime_error("Unknown kernel file: " + name);
+}
+
+static void appendKernelFile(const std::string& name, std::set<std::string>& included, std::string& output) {
+    if (!included.insert(name).second) {
+        return;
+    }
+    
+    const std::string directive = "#include \"";
+    std::string_view source = findEmbeddedKernel(name);
+    size_t start = 0;
+    while (start < source.size()) {
+        size_t end = source.find('\n', start);
+        end = (end == std::string_view::npos) ? source.size() : end + 1;
+        std::string_view line = source.substr(start, end - start);
+        
+        size_t first = line.find_first_not_of(" \t");
+        if (first != std::string_view::npos && line.substr(first, directive.size()) == directive) {
+            size_t close = line.find('"', first + directive.size());
+            if (close == std::string_view::npos) {
+                throw std::runtime_error("Malformed #include in kernel file " + name);
+            }
+            appendKernelFile(std::string(line.substr(first + directive.size(), close - first - directive.size())), included, output);
+        } else {
+            output.append(line.data(), line.size());
+        }
+        start = end;
+    }
+    if (!output.empty() && output.back() != '\n') {
+        output += '\n';
+    }
+}
+
+std::string assembleKernelSource(const std::string& root) {
+    static std::mutex mutex;
+    static std::map<std::string, std::string> assembled;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = assembled.find(root);
+    if (it == assembled.end()) {
+        std::string source;
+        std::set<std::string> included;
+        appendKernelFile(root, included, source);
+        it = assembled.emplace(root, std::move(source)).first;
+    }
+    return it->second;
+}
+
+void spliceMetricSource(std::string& kernelSource, const std::string& metricSource) {
+    const std::string marker = "// @METRIC_SOURCE@";
+    size_t pos = kernelSource.find(marker);
+    if (pos == std::string::npos) {
+        throw std::runtime_error("Kernel has no metric source marker");
+    }
+    kernelSource.replace(pos, marker.size(), metricSource);
+}
+
+// Runtime parameters map to their metric_data slot, so the source stays the
+// same when they change; structural ones are baked in
+std::string composeMetricSource(const IMetric& metric) {
+    if (!metric.hasKernelSource()) {
+        return "";
+    }
+    std::string source = metric.getKernelSource();
+    if (source.empty()) {
+        return source;
+    }
+    
+    std::string defines;
+    size_t slot = 0;
+    for (const auto& [key, param] : metric.getParameters()) {
+        std::string name = "PARAM_";
+        for (char c : key) {
+            name += std::isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : '_';
+        }
+        
+        if (metric.isStructuralParameter(key) || slot >= kMaxMetricParams) {
+            char literal[32];
+            std::snprintf(literal, sizeof(literal), "%.9gf", param.value);
+            defines += "#define " + name + " " + literal + "\n";
+        } else {
+            defines += "#define " + name + " (metric_data[METRIC_DATA_PARAMS + " + std::to_string(slot++) + "])\n";
+        }
+    }
+    return defines + source;
+}
+
+std::string kernelDefines(const KernelConfig& config) {
+    std::string defines;
+    if (config.metricSource) {
+        defines += " -DMETRIC_SOURCE";
+    }
+    if (config.outputToBuffer) {
+        defines += " -DOUTPUT_TO_BUFFER";
+    }
+    defines += " -D" + config.outputFormat;
+    defines += " -D" + config.integrator;
+    if (config.kerrMino) {
+        defines += " -DKERR_MINO";
+    }
+    defines += " -DTILE_WIDTH=" + std::to_string(config.tileWidth);
+    defines += " -DTILE_HEIGHT=" + std::to_string(config.tileHeight);
+    defines += " -DSCAN_BLOCK_SIZE=" + std::to_string(config.scanBlockSize);
+    return defines;
+}
+
+KernelConfig startupKernelConfig(bool isCPU, bool isPOCL, bool isNVIDIA) {
+    KernelConfig config;
+    
+    // CPU devices (POCL in particular) see host memory as device memory
+    config.outputToBuffer = isPOCL || isCPU;
+    
+    // Square tiles keep a work-group's rays spatially coherent. CPU devices
+    // vectorize across the group, NVIDIA prefers 128-item groups.
+    if (!isCPU && isNVIDIA) {
+        config.tileWidth = 16;
+        config.tileHeight = 8;
+    }
+    return config;
+}
+
+uint64_t fnv1a(const std::string& data, uint64_t seed) {
+    uint64_t h = seed;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint64_t kernelVariantKey(const std::string& source, const std::string& defines) {
+    std::istringstream stream(defines);
+    std::vector<std::string> tokens((std::istream_iterator<std::string>(stream)), std::istream_iterator<std::string>());
+    std::sort(tokens.begin(), tokens.end());
+    
+    uint64_t key = fnv1a(source);
+    for (const auto& token : tokens) {
+        key = fnv1a(std::string(1, '\0') + token, key);
+    }
+    return key;
+}
+
+std::string kernelVariantName(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+    return name;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+class IMetric;
+
+// Kernel source assembly, shared by the renderer and the offline kernel
+// compiler so that both produce byte-identical variants
+
+// Metric parameters read from metric_data at run time; any beyond are baked in
+constexpr size_t kMaxMetricParams = 16;
+
+// A file of kernels/, embedded at build time by cmake/EmbedKernels.cmake
+struct EmbeddedKernelFile {
+    const char* name; // Relative to kernels/
+    const unsigned char* data;
+    size_t size;
+};
+extern const EmbeddedKernelFile kEmbeddedKernels[];
+extern const size_t kEmbeddedKernelCount;
+
+// The program rooted at an embedded file, with every #include "<file>" line
+// replaced by that embedded file, each included once. Assembled programs are
+// kept, so later calls do no work.
+std::string assembleKernelSource(const std::string& root = "raytracer.cl");
+
+// Replace the metric marker in the kernel with the metric's device code
+void spliceMetricSource(std::string& kernelSource, const std::string& metricSource);
+
+// The metric's device code, preceded by a PARAM_<NAME> define per parameter,
+// or empty when the metric has none
+std::string composeMetricSource(const IMetric& metric);
+
+// 64-bit FNV-1a, continuing from seed
+uint64_t fnv1a(const std::string& data, uint64_t seed = 0xcbf29ce484222325ull);
+
+// Build choices that select kernel code, turned into -D defines the same way
+// by the renderer and the offline kernel compiler
+struct KernelConfig {
+    bool metricSource = false;   // The metric's device code replaces the generic hooks
+    bool kerrMino = false;       // Kerr rays traced from their constants of motion
+    bool outputToBuffer = false; // Mapped buffer output instead of an image
+    std::string outputFormat = "OUTPUT_FORMAT_RGBA8";
+    std::string integrator = "INTEGRATOR_DOPRI5";
+    int tileWidth = 8, tileHeight = 8; // Work-group tile, also the ray ordering
+    int scanBlockSize = 256;           // Power-of-two group of the compaction kernels
+};
+std::string kernelDefines(const KernelConfig& config);
+
+// The configuration the renderer starts with on a device of this kind, before
+// device limits shrink the work-groups. The offline compiler enumerates it to
+// build exactly the variants the renderer requests at startup.
+KernelConfig startupKernelConfig(bool isCPU, bool isPOCL, bool isNVIDIA);
+
+// Identifies a kernel variant by its spliced source and -D defines, in any
+// order. Offline compiled variants are stored as kernelVariantName(key).
+uint64_t kernelVariantKey(const std::string& source, const std::string& defines);
+std::string kernelVariantName(uint64_t key);
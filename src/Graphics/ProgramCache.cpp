@@ -0,0 +1,156 @@
+#include "ProgramCache.h"
+#include "KernelSource.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+// OpenCL 3.0 includes
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_MINIMUM_OPENCL_VERSION 200
+#define CL_HPP_TARGET_OPENCL_VERSION 300
+#include <CL/cl.h>
+#include <CL/opencl.hpp>
+
+ProgramCache::ProgramCache(const cl::Context& context, const cl::Device& device, std::string directory)
+    : m_Context(context), m_Device(device), m_Directory(std::move(directory)) {
+    // Binaries are only valid for the device and driver that produced them
+    m_DeviceHash = fnv1a(m_Device.getInfo<CL_DEVICE_NAME>());
+    m_DeviceHash = fnv1a(m_Device.getInfo<CL_DEVICE_VERSION>(), m_DeviceHash);
+    m_DeviceHash = fnv1a(m_Device.getInfo<CL_DRIVER_VERSION>(), m_DeviceHash);
+}
+
+ProgramCache::~ProgramCache() = default;
+
+std::string ProgramCache::defaultDirectory() {
+    // Per-user cache location of the platform, so runs from different
+    // working directories share binaries and nothing lands next to the data
+#ifdef _WIN32
+    if (const char* localAppData = std::getenv("LOCALAPPDATA")) {
+        return (std::filesystem::path(localAppData) / "Sirius" / "kernel_cache").string();
+    }
+#else
+    if (const char* xdgCache = std::getenv("XDG_CACHE_HOME"); xdgCache && *xdgCache) {
+        return (std::filesystem::path(xdgCache) / "sirius" / "kernels").string();
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return (std::filesystem::path(home) / ".cache" / "sirius" / "kernels").string();
+    }
+#endif
+    std::error_code ec;
+    return (std::filesystem::temp_directory_path(ec) / "sirius-kernel-cache").string();
+}
+
+cl::Program ProgramCache::getProgram(const std::string& source, const std::string& options,
+                                     const std::vector<char>* il) {
+    // The separator keeps "ab" + "c" and "a" + "bc" apart
+    uint64_t key = fnv1a(options, fnv1a(std::string(1, '\0'), fnv1a(source, m_DeviceHash)));
+    
+    {
+        std::lock_guard<std::mutex> lock(m_ProgramsMutex);
+        auto it = m_Programs.find(key);
+        if (it != m_Programs.end()) {
+            return *it->second;
+        }
+    }
+    
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    std::string path = (std::filesystem::path(m_Directory) / name).string();
+    
+    cl::Program program;
+    if (loadBinary(path, options, program)) {
+        std::cout << "Loaded cached kernel binary " << name << std::endl;
+    } else {
+        if (il && buildFromIL(*il, options, program)) {
+            std::cout << "Built kernel from offline SPIR-V" << std::endl;
+        } else {
+            program = cl::Program(m_Context, source);
+            program.build({m_Device}, options.c_str());
+        }
+        storeBinary(path, program);
+    }
+    
+    // Two threads missing on the same key both build; the first one stored wins
+    std::lock_guard<std::mutex> lock(m_ProgramsMutex);
+    auto it = m_Programs.try_emplace(key, std::make_unique<cl::Program>(program)).first;
+    return *it->second;
+}
+
+void ProgramCache::clear() {
+    std::lock_guard<std::mutex> lock(m_ProgramsMutex);
+    m_Programs.clear();
+}
+
+bool ProgramCache::loadBinary(const std::string& path, const std::string& options, cl::Program& program) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<unsigned char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) {
+        return false;
+    }
+    
+    // A stale or truncated binary is rejected here and rebuilt from source
+    try {
+        std::vector<cl_int> status;
+        program = cl::Program(m_Context, {m_Device}, cl::Program::Binaries{binary}, &status);
+        program.build({m_Device}, options.c_str());
+        return true;
+    } catch (const cl::Error& err) {
+        std::cerr << "Discarding cached kernel binary " << path << ": " << err.what() << std::endl;
+        return false;
+    }
+}
+
+bool ProgramCache::buildFromIL(const std::vector<char>& il, const std::string& options, cl::Program& program) const {
+    // Preprocessor options are ignored for IL; the rest still apply
+    try {
+        program = cl::Program(m_Context, il);
+        program.build({m_Device}, options.c_str());
+        return true;
+    } catch (const cl::Error& err) {
+        std::cerr << "Offline SPIR-V rejected, building from source: " << err.what() << std::endl;
+        return false;
+    }
+}
+
+void ProgramCache::storeBinary(const std::string& path, const cl::Program& program) const {
+    try {
+        auto binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+        if (binaries.empty() || binaries[0].empty()) {
+            return;
+        }
+        
+        // Written under a temporary name unique to this writer and renamed,
+        // so a concurrent or interrupted run never reads a partial file
+        std::error_code ec;
+        std::filesystem::create_directories(m_Directory, ec);
+        std::random_device random;
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+        std::string temp = path + suffix;
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                return;
+            }
+            file.write(reinterpret_cast<const char*>(binaries[0].data()), binaries[0].size());
+        }
+        if (std::filesystem::file_size(temp, ec) != binaries[0].size()) {
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+        std::filesystem::rename(temp, path, ec);
+        if (ec) {
+            std::filesystem::remove(temp, ec);
+        }
+    } catch (const cl::Error& err) {
+        std::cerr << "Could not store kernel binary: " << err.what() << std::endl;
+    }
+}
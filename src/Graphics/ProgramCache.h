@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// Forward-declare OpenCL types
+namespace cl { class Context; class Device; class Program; }
+
+// Built OpenCL programs, kept in memory for the session and as device
+// binaries on disk across runs. Entries are keyed by a hash of the source,
+// the build options and the device and driver, so any change to one of them
+// misses and rebuilds. getProgram() may be called from several threads at
+// once; builds run outside the lock.
+class ProgramCache {
+public:
+    ProgramCache(const cl::Context& context, const cl::Device& device, std::string directory);
+    ~ProgramCache();
+
+    // Returns the built program, building it on a miss. A miss builds from
+    // il when given, an offline compiled SPIR-V module of the same source,
+    // and from source otherwise or when the IL is rejected. Throws
+    // cl::BuildError when the source does not build with these options.
+    cl::Program getProgram(const std::string& source, const std::string& options,
+                           const std::vector<char>* il = nullptr);
+
+    // Per-user cache directory for the binaries, independent of the working
+    // directory
+    static std::string defaultDirectory();
+
+    // Drops the in-memory programs; the disk cache is kept
+    void clear();
+
+private:
+    bool loadBinary(const std::string& path, const std::string& options, cl::Program& program) const;
+    void storeBinary(const std::string& path, const cl::Program& program) const;
+    bool buildFromIL(const std::vector<char>& il, const std::string& options, cl::Program& program) const;
+
+    const cl::Context& m_Context;
+    const cl::Device& m_Device;
+    std::string m_Directory;
+    uint64_t m_DeviceHash = 0; // Device name and driver version
+    std::mutex m_ProgramsMutex; // Guards m_Programs
+    std::unordered_map<uint64_t, std::unique_ptr<cl::Program>> m_Programs;
+};
@@ -1,4 +1,6 @@
 #include "Renderer.h"
+#include "ProgramCache.h"
+#include "KernelSource.h"
 #include "Physics/IMetric.h"
 #include <glad/glad.h>
 #include <stdexcept>
@@ -9,6 +11,9 @@
 #include <cmath>
 #include <chrono>
 #include <regex>
+#include <algorithm>
+#include <future>
+#include <filesystem>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -22,12 +27,27 @@
 #include <CL/cl.h>
 #include <CL/opencl.hpp>
 
-std::string loadKernelSource(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open kernel file: " + path);
+// Whether the device takes SPIR-V through clCreateProgramWithIL (OpenCL 2.1+)
+bool supportsSpirv(const cl::Device& device) {
+    try {
+        return device.getInfo<CL_DEVICE_IL_VERSION>().find("SPIR-V") != std::string::npos;
+    } catch (const cl::Error&) {
+        return false;
+    }
+}
+
+// Directory of the running executable, where the build puts kernels/spirv.
+// Offline variants are only compiled on Linux; elsewhere, and if the link
+// cannot be read, this is the working directory.
+static std::filesystem::path executableDirectory() {
+    std::error_code ec;
+#ifdef __linux__
+    std::filesystem::path exe = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (!ec) {
+        return exe.parent_path();
     }
-    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+#endif
+    return std::filesystem::current_path(ec);
 }
 
 // Extract POCL version from platform version string
@@ -40,7 +60,110 @@ std::pair<int, int> extractPOCLVersion(const std::string& versionStr) {
     return {0, 0}; // Unknown version
 }
 
-Renderer::Renderer(int width, int height) : m_Width(width), m_Height(height), m_OutputTextureID(0) {
+// Matching OpenCL image, OpenGL texture and kernel settings for an output format
+struct OutputFormatInfo {
+    const char* name;
+    const char* define;
+    cl_channel_order clOrder;
+    cl_channel_type clType;
+    GLenum glInternalFormat;
+    GLenum glFormat;
+    GLenum glType;
+    size_t bytesPerPixel;
+};
+
+static const OutputFormatInfo& getFormatInfo(OutputFormat format) {
+    // CL_UNORM_INT_101010 packs R/G/B into bits 29-20/19-10/9-0, which is
+    // what GL reads as BGRA with GL_UNSIGNED_INT_2_10_10_10_REV
+    static const OutputFormatInfo formats[] = {
+        {"RGBA8",   "OUTPUT_FORMAT_RGBA8",   CL_RGBA, CL_UNORM_INT8,       GL_RGBA8,    GL_RGBA, GL_UNSIGNED_BYTE,               4},
+        {"RGBA16F", "OUTPUT_FORMAT_RGBA16F", CL_RGBA, CL_HALF_FLOAT,       GL_RGBA16F,  GL_RGBA, GL_HALF_FLOAT,                  8},
+        {"RGB10A2", "OUTPUT_FORMAT_RGB10A2", CL_RGB,  CL_UNORM_INT_101010, GL_RGB10_A2, GL_BGRA, GL_UNSIGNED_INT_2_10_10_10_REV, 4},
+        {"RGBA32F", "OUTPUT_FORMAT_RGBA32F", CL_RGBA, CL_FLOAT,            GL_RGBA32F,  GL_RGBA, GL_FLOAT,                       16},
+    };
+    return formats[static_cast<int>(format)];
+}
+
+const char* Renderer::getOutputFormatName(OutputFormat format) {
+    return getFormatInfo(format).name;
+}
+
+// One entry of the frames-in-flight ring: its own output target plus the
+// event that signals the result is ready on the host. With pixel buffers the
+// result lands in a persistently mapped GL unpack buffer, so the texture
+// update is sourced from the PBO instead of client memory.
+struct Renderer::FrameSlot {
+    std::unique_ptr<cl::Image2D> image;  // Copy path
+    std::unique_ptr<cl::Buffer> buffer;  // Mapped path
+    std::vector<unsigned char> pixels;   // Copy path staging memory (no PBO)
+    void* mapped = nullptr;              // Mapped path host pointer
+    cl::Event started;                   // First command of the frame
+    cl::Event traced;                    // Last trace or shade kernel; with started, profiled for the resolution controller
+    cl::Event ready;                     // Readback or map completion
+    bool pending = false;
+    cl_int liveRays = 0;                 // Progressive mode, read back with the frame
+    uint64_t progressiveEpoch = 0;       // 0 when the frame carries no live count
+
+    GLuint pbo = 0;
+    void* pboData = nullptr;             // Persistent mapping of the PBO
+    GLsync uploadFence = nullptr;        // Last texture update sourced from the PBO
+
+    ~FrameSlot() {
+        // The CL buffer may wrap the PBO memory, release it first
+        buffer.reset();
+        if (uploadFence) {
+            glDeleteSync(uploadFence);
+        }
+        if (pbo) {
+            glDeleteBuffers(1, &pbo);
+        }
+    }
+
+    // Block until GL is done reading the PBO before it is written again
+    void waitForUpload() {
+        if (!uploadFence) return;
+        while (glClientWaitSync(uploadFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(uploadFence);
+        uploadFence = nullptr;
+    }
+};
+
+// Everything sized by the render resolution. Sets are allocated for a size
+// bucket and reused for any resolution that fits, so resizing the viewport
+// only reallocates when it crosses into a bucket that isn't pooled yet.
+struct Renderer::ResourceSet {
+    int capacityWidth = 0, capacityHeight = 0;
+    GLuint texture = 0;
+
+    // Ray state as a structure of arrays, see kernels/common.cl
+    std::unique_ptr<cl::Buffer> rayPositions;  // float4
+    std::unique_ptr<cl::Buffer> rayVelocities; // float4
+    std::unique_ptr<cl::Buffer> rayFlags;      // uchar
+    std::unique_ptr<cl::Buffer> rayStepSizes;  // float
+    std::unique_ptr<cl::Buffer> liveCount;     // int
+    
+    // Wavefront mode only
+    std::unique_ptr<cl::Buffer> activeRays[2]; // int, current and next active list
+    std::unique_ptr<cl::Buffer> activeCounts[2]; // int, length of each active list
+    std::unique_ptr<cl::Buffer> scanOffsets;   // int, per active entry
+    std::unique_ptr<cl::Buffer> blockSums;     // int, per scan block
+    std::vector<std::unique_ptr<FrameSlot>> slots;
+
+    ~ResourceSet() {
+        slots.clear();
+        if (texture) {
+            glDeleteTextures(1, &texture);
+        }
+    }
+};
+
+static int roundUpToBucket(int size) {
+    return ((std::max(size, 1) + Renderer::kSizeBucket - 1) / Renderer::kSizeBucket) * Renderer::kSizeBucket;
+}
+
+Renderer::Renderer(int width, int height) : m_Width(width), m_Height(height), m_ViewportWidth(width), m_ViewportHeight(height) {
+    setCamera(Vec4(0.0f, 0.0f, 0.0f, -5.0f), Quat(1.0f, 0.0f, 0.0f, 0.0f), 60.0f);
+
     std::cout << "Initializing OpenCL Renderer..." << std::endl;
     
     try {
@@ -90,16 +213,30 @@ Renderer::Renderer(int width, int height) : m_Width(width), m_Height(height), m_
         
         std::cout << "Device: " << deviceName << " (" << computeUnits << " compute units)" << std::endl;
         
+        bool isCPU = (m_Device->getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU) != 0;
+        
         // Create context and queue
         m_Context = std::make_unique<cl::Context>(*m_Device);
-        m_Queue = std::make_unique<cl::CommandQueue>(*m_Context, *m_Device);
+        m_Queue = std::make_unique<cl::CommandQueue>(*m_Context, *m_Device, CL_QUEUE_PROFILING_ENABLE);
+        m_ProgramCache = std::make_unique<ProgramCache>(*m_Context, *m_Device, ProgramCache::defaultDirectory());
         
         // Store platform info for later use
         m_IsPOCL = isPOCL;
         m_IsNVIDIA = isNVIDIA;
         m_HasRealOpenCL30 = hasRealOpenCL30;
-        
-        createResources(width, height);
+        m_SupportsSpirv = supportsSpirv(*m_Device);
+        m_OfflineKernelDir = (executableDirectory() / "kernels" / "spirv").string();
+        KernelConfig startup = startupKernelConfig(isCPU, isPOCL, isNVIDIA);
+        m_UseMappedOutput = startup.outputToBuffer;
+        // The default format must be writable as an image; if not, the kernel
+        // packs pixels into a mapped buffer, which works for every format
+        if (!m_UseMappedOutput && !isImageFormatSupported(m_OutputFormat)) {
+            std::cout << "Warning: " << getOutputFormatName(m_OutputFormat) << " images not supported by device, using a mapped buffer" << std::endl;
+            m_UseMappedOutput = true;
+        }
+        chooseTileShape(startup);
+        m_MetricData = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_ONLY, kMetricDataSize * sizeof(float));
+        m_MetricValues.resize(kMetricDataSize);
         
         std::cout << "OpenCL Renderer initialized successfully!" << std::endl;
         
@@ -109,43 +246,412 @@ Renderer::Renderer(int width, int height) : m_Width(width), m_Height(height), m_
     }
 }
 
+void Renderer::createResources() {
+    m_UsePixelBuffers = GLAD_GL_VERSION_4_4 != 0; // Persistent mapping needs glBufferStorage
+    std::cout << "Output path: " << (m_UseMappedOutput ? "mapped host buffer (zero-copy)" : "image readback")
+              << (m_UsePixelBuffers ? " via persistent PBOs" : "") << std::endl;
+    
+    try {
+        acquireResources(m_Width, m_Height);
+    } catch (const cl::Error& err) {
+        std::cerr << "OpenCL Error: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
+        throw std::runtime_error("Failed to create render targets");
+    }
+}
+
 Renderer::~Renderer() {
-    if (m_OutputTextureID) {
-        glDeleteTextures(1, &m_OutputTextureID);
+    // A build in flight uses the context; wait for it
+    m_PendingBuild = nullptr;
+    try {
+        drainFrames(false);
+    } catch (const cl::Error& err) {
+        std::cerr << "OpenCL Error during shutdown: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
     }
+    m_Resources = nullptr;
+    m_DisplaySet = nullptr;
+    m_ResourcePool.clear();
 }
 
-void Renderer::createResources(int width, int height) {
+void Renderer::acquireResources(int width, int height) {
+    // In-flight frames were traced for the current set and size
+    drainFrames(true);
+
+    int capacityWidth = roundUpToBucket(width);
+    int capacityHeight = roundUpToBucket(height);
+
+    // Reuse a pooled set for this bucket, most recently used first
+    auto it = std::find_if(m_ResourcePool.begin(), m_ResourcePool.end(), [&](const auto& set) {
+        return set->capacityWidth == capacityWidth && set->capacityHeight == capacityHeight;
+    });
+    std::unique_ptr<ResourceSet> set;
+    if (it != m_ResourcePool.end()) {
+        set = std::move(*it);
+        m_ResourcePool.erase(it);
+    } else {
+        set = createResourceSet(capacityWidth, capacityHeight);
+    }
+    m_ResourcePool.insert(m_ResourcePool.begin(), std::move(set));
+    if (m_ResourcePool.size() > kMaxPooledSizes) {
+        if (m_ResourcePool.back().get() == m_DisplaySet) {
+            m_DisplaySet = nullptr;
+        }
+        m_ResourcePool.pop_back();
+    }
+    m_Resources = m_ResourcePool.front().get();
+
     m_Width = width;
     m_Height = height;
+    m_NextSlot = 0;
+    m_PendingFrames = 0;
+
+    m_Camera.aspect = static_cast<float>(width) / static_cast<float>(height);
+    m_Camera.width = width;
+    m_Camera.height = height;
+    m_CameraDirty = true;
+    m_MetricDataDirty = true; // The metric snapshot is taken at the observer
+    ++m_SceneGeneration;
+}
+
+void Renderer::setTraceParams(const TraceParams& params) {
+    float horizonRadius = m_TraceParams.horizonRadius;
+    m_TraceParams = params;
+    m_TraceParams.horizonRadius = horizonRadius;
+    m_TransferDirty = true;
+    m_TraceParams.stepSize = std::max(params.stepSize, 1e-4f);
+    m_TraceParams.maxSteps = std::max(params.maxSteps, 1);
+    m_TraceParams.absTolerance = std::max(params.absTolerance, 1e-8f);
+    m_TraceParams.relTolerance = std::max(params.relTolerance, 1e-8f);
+    ++m_SceneGeneration;
+}
+
+const TraceParams& Renderer::getTraceParams() const {
+    return m_TraceParams;
+}
+
+void Renderer::setWavefront(bool enabled, int stepsPerRound) {
+    m_WavefrontSteps = std::max(stepsPerRound, 1);
+    ++m_SceneGeneration;
+    if (enabled == m_Wavefront) return;
+    
+    try {
+        m_Wavefront = enabled;
+        clearResourcePool(); // Allocates or drops the active lists
+    } catch (const cl::Error& err) {
+        std::cerr << "Failed to switch wavefront mode: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
+    }
+}
+
+void Renderer::setProgressive(bool enabled, int stepsPerFrame) {
+    m_ProgressiveBudget = std::max(stepsPerFrame, 1);
+    if (enabled == m_Progressive) return;
+    m_Progressive = enabled;
+    m_Stats.liveRays = 0;
+    // Progressive frames advance the rays in place; the single-pass trace
+    // only regenerates them on a camera change, so force one either way
+    m_CameraDirty = true;
+    ++m_SceneGeneration; // Start over from fresh rays
+}
 
-    if (m_OutputTextureID) {
-        glDeleteTextures(1, &m_OutputTextureID);
+bool Renderer::isProgressiveEnabled() const {
+    return m_Progressive;
+}
+
+int Renderer::getProgressiveStepsPerFrame() const {
+    return m_ProgressiveBudget;
+}
+
+bool Renderer::isWavefrontEnabled() const {
+    return m_Wavefront;
+}
+
+int Renderer::getWavefrontSteps() const {
+    return m_WavefrontSteps;
+}
+
+void Renderer::setIntegrator(Integrator integrator) {
+    if (integrator == m_Integrator) return;
+    m_Integrator = integrator;
+    m_KernelDirty = true; // The integrator is compiled into the kernel
+}
+
+Integrator Renderer::getIntegrator() const {
+    return m_Integrator;
+}
+
+const char* Renderer::getIntegratorName(Integrator integrator) {
+    switch (integrator) {
+        case Integrator::RK4: return "RK4 (fixed step)";
+        case Integrator::DormandPrince: return "Dormand-Prince RK45";
+        case Integrator::Symplectic: return "Symplectic (Hamiltonian)";
     }
+    return "Unknown";
+}
+
+bool Renderer::isKerrGeodesicsActive() const {
+    return m_KerrGeodesics;
+}
+
+void Renderer::clearResourcePool() {
+    drainFrames(false);
+    m_Resources = nullptr;
+    m_DisplaySet = nullptr;
+    m_ResourcePool.clear();
+    acquireResources(m_Width, m_Height);
+}
+
+std::unique_ptr<Renderer::ResourceSet> Renderer::createResourceSet(int capacityWidth, int capacityHeight) {
+    auto set = std::make_unique<ResourceSet>();
+    set->capacityWidth = capacityWidth;
+    set->capacityHeight = capacityHeight;
+
+    const OutputFormatInfo& info = getFormatInfo(m_ResourceFormat);
 
     // Create OpenGL texture
-    glGenTextures(1, &m_OutputTextureID);
-    glBindTexture(GL_TEXTURE_2D, m_OutputTextureID);
+    glGenTextures(1, &set->texture);
+    glBindTexture(GL_TEXTURE_2D, set->texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    if (m_ResourceFormat == OutputFormat::RGB10A2) {
+        // The packed 2-bit alpha is left unused by the device
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, info.glInternalFormat, capacityWidth, capacityHeight, 0, info.glFormat, info.glType, nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     // Create OpenCL resources
-    cl::ImageFormat format(CL_RGBA, CL_FLOAT);
-    m_OutputImage = std::make_unique<cl::Image2D>(*m_Context, CL_MEM_WRITE_ONLY, format, width, height);
+    size_t capacity = static_cast<size_t>(capacityWidth) * capacityHeight;
+    set->rayPositions = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_float4) * capacity);
+    set->rayVelocities = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_float4) * capacity);
+    set->rayFlags = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_uchar) * capacity);
+    set->rayStepSizes = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_float) * capacity);
+    set->liveCount = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_int));
+    if (m_Wavefront) {
+        size_t blocks = (capacity + m_ScanBlockSize - 1) / m_ScanBlockSize;
+        set->activeRays[0] = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_int) * capacity);
+        set->activeRays[1] = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_int) * capacity);
+        set->activeCounts[0] = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_int));
+        set->activeCounts[1] = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_int));
+        set->scanOffsets = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_int) * capacity);
+        set->blockSums = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_WRITE, sizeof(cl_int) * blocks);
+    }
+
+    size_t outputSize = info.bytesPerPixel * capacity;
+    for (int i = 0; i < m_FramesInFlight; ++i) {
+        auto slot = std::make_unique<FrameSlot>();
+        if (m_UsePixelBuffers) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glGenBuffers(1, &slot->pbo);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, outputSize, nullptr, flags);
+            slot->pboData = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, outputSize, flags);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        
+        if (m_UseMappedOutput) {
+            if (slot->pboData) {
+                // The kernel writes straight into the PBO memory
+                slot->buffer = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, outputSize, slot->pboData);
+            } else {
+                slot->buffer = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, outputSize);
+            }
+        } else {
+            if (!slot->pboData) {
+                slot->pixels.resize(outputSize);
+            }
+            cl::ImageFormat format(info.clOrder, info.clType);
+            slot->image = std::make_unique<cl::Image2D>(*m_Context, CL_MEM_WRITE_ONLY, format, capacityWidth, capacityHeight);
+        }
+        set->slots.push_back(std::move(slot));
+    }
+    return set;
+}
+
+void Renderer::resize(int viewportWidth, int viewportHeight) {
+    m_ViewportWidth = std::max(viewportWidth, 1);
+    m_ViewportHeight = std::max(viewportHeight, 1);
+
+    float scale = m_RenderScale * (m_DynamicResolution ? m_AppliedDynamicScale : 1.0f);
+    int width = std::max(static_cast<int>(std::lround(m_ViewportWidth * scale)), kMinRenderSize);
+    int height = std::max(static_cast<int>(std::lround(m_ViewportHeight * scale)), kMinRenderSize);
+    if (width == m_Width && height == m_Height) return;
+
+    try {
+        acquireResources(width, height);
+    } catch (const cl::Error& err) {
+        std::cerr << "Failed to resize render targets: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
+    }
+}
+
+void Renderer::setRenderScale(float scale) {
+    m_RenderScale = std::clamp(scale, 0.1f, 2.0f);
+    resize(m_ViewportWidth, m_ViewportHeight);
+}
+
+float Renderer::getRenderScale() const {
+    return m_RenderScale;
+}
+
+void Renderer::setDynamicResolution(bool enabled, float frameBudgetMs) {
+    m_FrameBudgetMs = std::max(frameBudgetMs, 1.0f);
+    if (enabled != m_DynamicResolution) {
+        m_DynamicResolution = enabled;
+        m_DynamicScale = 1.0f;
+        m_AppliedDynamicScale = 1.0f;
+        m_Stats.dynamicScale = 1.0f;
+        resize(m_ViewportWidth, m_ViewportHeight);
+    }
+}
+
+bool Renderer::isDynamicResolutionEnabled() const {
+    return m_DynamicResolution;
+}
+
+float Renderer::getFrameBudget() const {
+    return m_FrameBudgetMs;
+}
+
+const RenderStats& Renderer::getStats() const {
+    return m_Stats;
+}
+
+void Renderer::updateDynamicResolution(float kernelTimeMs) {
+    // Smooth the measurement so a single slow frame doesn't cause a jump
+    const float smoothing = 0.2f;
+    if (m_Stats.kernelTimeMs <= 0.0f) {
+        m_Stats.kernelTimeMs = kernelTimeMs;
+    } else {
+        m_Stats.kernelTimeMs += smoothing * (kernelTimeMs - m_Stats.kernelTimeMs);
+    }
+    if (!m_DynamicResolution || m_Stats.kernelTimeMs <= 0.0f) return;
+
+    // Trace cost scales with pixel count, i.e. with the square of the scale
+    float target = m_DynamicScale * std::sqrt(m_FrameBudgetMs / m_Stats.kernelTimeMs);
+    m_DynamicScale += 0.25f * (target - m_DynamicScale);
+    m_DynamicScale = std::clamp(m_DynamicScale, kMinDynamicScale, 1.0f);
+    m_Stats.dynamicScale = m_DynamicScale;
+
+    // Only resize on meaningful changes, every resize drains the frame ring
+    if (std::abs(m_DynamicScale - m_AppliedDynamicScale) > 0.05f * m_AppliedDynamicScale) {
+        m_AppliedDynamicScale = m_DynamicScale;
+        m_ResolutionDirty = true;
+    }
+}
+
+Vec2 Renderer::getOutputUV() const {
+    if (m_DisplaySet) return m_DisplayUV;
+    if (!m_Resources) return Vec2(1.0f, 1.0f);
+    return Vec2(static_cast<float>(m_Width) / m_Resources->capacityWidth,
+                static_cast<float>(m_Height) / m_Resources->capacityHeight);
+}
+
+void Renderer::setFramesInFlight(int count) {
+    count = std::clamp(count, 1, kMaxFramesInFlight);
+    if (count == m_FramesInFlight) return;
+    
+    try {
+        drainFrames(true);
+        m_FramesInFlight = count;
+        clearResourcePool();
+    } catch (const cl::Error& err) {
+        std::cerr << "Failed to resize frame ring: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
+    }
+}
+
+int Renderer::getFramesInFlight() const {
+    return m_FramesInFlight;
+}
+
+void Renderer::chooseTileShape(const KernelConfig& startup) {
+    // The startup tile, shrunk to what the device can run
+    m_TileWidth = startup.tileWidth;
+    m_TileHeight = startup.tileHeight;
+    
+    size_t maxGroupSize = m_Device->getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    while (static_cast<size_t>(m_TileWidth * m_TileHeight) > maxGroupSize && m_TileHeight > 1) {
+        m_TileHeight /= 2;
+    }
+    std::cout << "Work-group tile: " << m_TileWidth << "x" << m_TileHeight << std::endl;
+    
+    // The compaction scan needs a power-of-two group
+    m_ScanBlockSize = startup.scanBlockSize;
+    while (static_cast<size_t>(m_ScanBlockSize) > maxGroupSize && m_ScanBlockSize > 1) {
+        m_ScanBlockSize /= 2;
+    }
+}
+
+cl::NDRange Renderer::getGlobalRange() const {
+    // Whole tiles; the kernels skip work-items outside the image
+    size_t width = ((m_Width + m_TileWidth - 1) / m_TileWidth) * m_TileWidth;
+    size_t height = ((m_Height + m_TileHeight - 1) / m_TileHeight) * m_TileHeight;
+    return cl::NDRange(width, height);
+}
+
+cl::NDRange Renderer::getLocalRange() const {
+    return cl::NDRange(m_TileWidth, m_TileHeight);
+}
+
+cl::NDRange Renderer::getLinearRange(int count) const {
+    size_t blocks = (std::max(count, 1) + m_ScanBlockSize - 1) / m_ScanBlockSize;
+    return cl::NDRange(blocks * m_ScanBlockSize);
+}
+
+int Renderer::getRayCount() const {
+    // Rays of whole tiles, as laid out by ray_index()
+    int width = ((m_Width + m_TileWidth - 1) / m_TileWidth) * m_TileWidth;
+    int height = ((m_Height + m_TileHeight - 1) / m_TileHeight) * m_TileHeight;
+    return width * height;
+}
 
-    m_InitialRays.resize(width * height);
-    m_RayBuffer = std::make_unique<cl::Buffer>(*m_Context, CL_MEM_READ_ONLY, sizeof(Ray) * m_InitialRays.size());
+bool Renderer::isImageFormatSupported(OutputFormat format) const {
+    const OutputFormatInfo& info = getFormatInfo(format);
+    std::vector<cl::ImageFormat> supported;
+    m_Context->getSupportedImageFormats(CL_MEM_WRITE_ONLY, CL_MEM_OBJECT_IMAGE2D, &supported);
+    for (const auto& f : supported) {
+        if (f.image_channel_order == info.clOrder && f.image_channel_data_type == info.clType) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Renderer::setOutputFormat(OutputFormat format) {
+    if (format == m_OutputFormat) return;
+    
+    // The image path needs the device to support the format as an image;
+    // RGBA8 is checked when the device is set up
+    if (!m_UseMappedOutput && !isImageFormatSupported(format)) {
+        std::cout << "Warning: " << getOutputFormatName(format) << " images not supported by device, using RGBA8" << std::endl;
+        format = OutputFormat::RGBA8;
+        if (format == m_OutputFormat) return;
+    }
+    
+    // The kernel packs pixels for its format, so the render targets switch
+    // when the rebuilt kernel is swapped in; until then the current kernel
+    // keeps writing the current targets
+    m_OutputFormat = format;
+    m_KernelDirty = true;
+}
+
+OutputFormat Renderer::getOutputFormat() const {
+    return m_OutputFormat;
+}
+
+void Renderer::setCamera(const Vec4& position, const Quat& orientation, float fovDegrees) {
+    m_Camera.position = position;
+    m_Camera.orientation = Vec4(orientation.x, orientation.y, orientation.z, orientation.w);
+    m_Camera.fov = fovDegrees * static_cast<float>(M_PI) / 180.0f;
+    m_Camera.aspect = static_cast<float>(m_Width) / static_cast<float>(m_Height);
+    m_Camera.width = m_Width;
+    m_Camera.height = m_Height;
+    m_CameraDirty = true;
+    ++m_SceneGeneration;
 }
 
 std::string Renderer::generateCompilerOptions(IMetric* metric) const {
     if (!metric) return "";
     
-    auto tensor = metric->getMetricTensor(Vec4(0.0, 0.0, 0.0, 0.0));
-    
     std::string options;
     
     if (m_HasRealOpenCL30) {
@@ -171,137 +677,668 @@ std::string Renderer::generateCompilerOptions(IMetric* metric) const {
         options += " -cl-unsafe-math-optimizations";
     }
     
-    // Metric tensor values
-    options += " -DMETRIC_G00=" + std::to_string(tensor[0][0].real);
-    options += " -DMETRIC_G11=" + std::to_string(tensor[1][1].real);
-    options += " -DMETRIC_G22=" + std::to_string(tensor[2][2].real);
-    options += " -DMETRIC_G33=" + std::to_string(tensor[3][3].real);
+    options += generateKernelDefines(metric);
     
     return options;
 }
 
-void Renderer::compileKernel(IMetric* metric) {
-    if (!metric) return;
+// Preprocessor definitions that select what the kernel computes; shared by
+// the regular and the fallback build
+std::string Renderer::generateKernelDefines(IMetric* metric) const {
+    KernelConfig config;
+    config.metricSource = metric->hasKernelSource();
+    // Kerr rays are traced from their constants of motion instead; the
+    // metric source provides KERR_MASS and KERR_SPIN
+    config.kerrMino = usesKerrGeodesics(metric);
+    config.outputToBuffer = m_UseMappedOutput;
+    config.outputFormat = getFormatInfo(m_OutputFormat).define;
+    switch (m_Integrator) {
+        case Integrator::RK4: config.integrator = "INTEGRATOR_RK4"; break;
+        case Integrator::DormandPrince: config.integrator = "INTEGRATOR_DOPRI5"; break;
+        case Integrator::Symplectic: config.integrator = "INTEGRATOR_SYMPLECTIC"; break;
+    }
+    config.tileWidth = m_TileWidth;
+    config.tileHeight = m_TileHeight;
+    config.scanBlockSize = m_ScanBlockSize;
+    return kernelDefines(config);
+}
+
+// SPIR-V for this variant from the offline kernel build, or empty when the
+// variant was not compiled ahead of time. Runs on the build worker.
+static std::vector<char> readOfflineKernel(const std::filesystem::path& directory, const std::string& source, const std::string& defines) {
+    std::ifstream file(directory / kernelVariantName(kernelVariantKey(source, defines)), std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+    return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// A program being built on a worker thread, and what the renderer takes over
+// from the metric once it is swapped in
+struct Renderer::KernelBuild {
+    std::future<cl::Program> program;
+    IMetric* metric = nullptr;
+    std::string metricSource;
+    uint64_t metricGeneration = 0;
+    bool kerrGeodesics = false;
+    std::string defines;       // Identifies the build when it fails
+    OutputFormat outputFormat; // Pixel layout the kernel writes
+};
+
+void Renderer::startKernelBuild(IMetric* metric) {
+    // Everything the build needs from the metric and the renderer is read
+    // here; the worker only goes through the program cache, which is safe to
+    // share with a build still running from a previous call
+    auto build = std::make_unique<KernelBuild>();
+    build->metric = metric;
+    build->metricSource = composeMetricSource(*metric);
+    build->metricGeneration = metric->getGeneration();
+    build->kerrGeodesics = usesKerrGeodesics(metric);
     
-    static bool compiling = false;
-    if (compiling) return;
-    compiling = true;
+    std::string kernelSource = assembleKernelSource();
+    if (!build->metricSource.empty()) {
+        spliceMetricSource(kernelSource, build->metricSource);
+    }
+    std::string defines = generateKernelDefines(metric);
+    build->defines = defines;
+    build->outputFormat = m_OutputFormat;
+    std::string options = generateCompilerOptions(metric);
+    std::string fallbackOptions = " -cl-std=CL1.2 -cl-mad-enable" + defines;
+    // Devices that cannot load IL skip the offline variants
+    std::string offlineDir = m_SupportsSpirv ? m_OfflineKernelDir : std::string();
     
-    try {
-        std::string kernelSource = loadKernelSource("kernels/raytracer.cl");
-        cl::Program program(*m_Context, kernelSource);
-        std::string options = generateCompilerOptions(metric);
-        
-        try {
-            program.build({*m_Device}, options.c_str());
-        } catch (const cl::BuildError& err) {
-            std::cerr << "Kernel build failed:" << std::endl;
-            auto buildLog = err.getBuildLog();
-            for (const auto& log : buildLog) {
-                std::cerr << log.second << std::endl;
+    ProgramCache* cache = m_ProgramCache.get();
+    build->program = std::async(std::launch::async,
+        [cache, kernelSource = std::move(kernelSource), defines, options, fallbackOptions, offlineDir]() {
+            std::vector<char> il;
+            if (!offlineDir.empty()) {
+                il = readOfflineKernel(offlineDir, kernelSource, defines);
             }
             
-            // Try minimal fallback
-            std::string fallbackOptions = " -cl-std=CL1.2 -cl-mad-enable";
-            fallbackOptions += " -DMETRIC_G00=" + std::to_string(metric->getMetricTensor(Vec4(0,0,0,0))[0][0].real);
-            fallbackOptions += " -DMETRIC_G11=" + std::to_string(metric->getMetricTensor(Vec4(0,0,0,0))[1][1].real);
-            fallbackOptions += " -DMETRIC_G22=" + std::to_string(metric->getMetricTensor(Vec4(0,0,0,0))[2][2].real);
-            fallbackOptions += " -DMETRIC_G33=" + std::to_string(metric->getMetricTensor(Vec4(0,0,0,0))[3][3].real);
-            
-            program.build({*m_Device}, fallbackOptions.c_str());
-            std::cout << "Using OpenCL 1.2 fallback compilation" << std::endl;
-        }
+            // Switching back to a metric, or restarting, reuses the built program
+            try {
+                return cache->getProgram(kernelSource, options, il.empty() ? nullptr : &il);
+            } catch (const cl::BuildError& err) {
+                std::cerr << "Kernel build failed:" << std::endl;
+                auto buildLog = err.getBuildLog();
+                for (const auto& log : buildLog) {
+                    std::cerr << log.second << std::endl;
+                }
+                
+                // Try minimal fallback
+                cl::Program program = cache->getProgram(kernelSource, fallbackOptions);
+                std::cout << "Using OpenCL 1.2 fallback compilation" << std::endl;
+                return program;
+            }
+        });
+    
+    std::cout << "Building kernel for " << metric->getName() << std::endl;
+    m_KernelDirty = false;
+    m_PendingBuild = std::move(build);
+}
 
-        m_Kernel = std::make_unique<cl::Kernel>(program, "trace_rays");
-        m_LastMetricName = metric->getName();
+// Swaps in the pending program once its build has finished. A failed build
+// keeps the previous kernel and is not retried until something changes.
+void Renderer::pollKernelBuild() {
+    if (!m_PendingBuild ||
+        m_PendingBuild->program.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    
+    std::unique_ptr<KernelBuild> build = std::move(m_PendingBuild);
+    try {
+        cl::Program program = build->program.get();
         
+        m_Kernel = std::make_unique<cl::Kernel>(program, "trace_rays");
+        m_RayGenKernel = std::make_unique<cl::Kernel>(program, "generate_rays");
+        m_InitActiveKernel = std::make_unique<cl::Kernel>(program, "init_active_rays");
+        m_WavefrontKernel = std::make_unique<cl::Kernel>(program, "trace_wavefront");
+        m_ScanKernel = std::make_unique<cl::Kernel>(program, "scan_active_rays");
+        m_ScanBlocksKernel = std::make_unique<cl::Kernel>(program, "scan_block_sums");
+        m_CompactKernel = std::make_unique<cl::Kernel>(program, "compact_active_rays");
+        m_ShadeKernel = std::make_unique<cl::Kernel>(program, "shade_rays");
+        m_AdvanceKernel = std::make_unique<cl::Kernel>(program, "advance_rays");
+        m_TransferKernel = std::make_unique<cl::Kernel>(program, "build_transfer_table");
+        m_LookupKernel = std::make_unique<cl::Kernel>(program, "lookup_rays");
     } catch (const std::exception& err) {
         std::cerr << "Kernel compilation error: " << err.what() << std::endl;
-        compiling = false;
-        throw;
+        m_FailedBuildMetric = build->metric;
+        m_FailedBuildGeneration = build->metricGeneration;
+        m_FailedBuildDefines = build->defines;
+        return;
+    }
+    
+    // Render targets follow the format of the kernel writing them
+    if (build->outputFormat != m_ResourceFormat) {
+        try {
+            m_ResourceFormat = build->outputFormat;
+            clearResourcePool();
+        } catch (const cl::Error& err) {
+            std::cerr << "Failed to change output format: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
+        }
     }
     
-    compiling = false;
+    m_KernelMetric = build->metric;
+    m_MetricSource = build->metricSource;
+    m_MetricSourceGeneration = build->metricGeneration;
+    m_KerrGeodesics = build->kerrGeodesics;
+    m_FailedBuildMetric = nullptr;
+    m_MetricDataDirty = true;
+    m_TransferDirty = true;
+    m_CameraDirty = true;
+    ++m_SceneGeneration;
 }
 
-void Renderer::render(IMetric* metric) {
-    if (!metric) return;
+bool Renderer::isCompiling() const {
+    return m_PendingBuild != nullptr;
+}
+
+void Renderer::prebuildKernel(IMetric* metric) {
+    if (!metric || m_PendingBuild || (m_Kernel && metric == m_KernelMetric)) return;
     
     try {
-        // Compile kernel if needed
-        if (!m_Kernel || m_LastMetricName != metric->getName()) {
-            compileKernel(metric);
+        startKernelBuild(metric);
+    } catch (const std::exception& err) {
+        // The first frame tries again and reports the error there
+        std::cerr << "Speculative kernel build not started: " << err.what() << std::endl;
+    }
+}
+
+bool Renderer::hasPresentedFrame() const {
+    return m_PresentedFrames > 0;
+}
+
+void Renderer::invalidate() {
+    ++m_SceneGeneration;
+}
+
+bool Renderer::render(IMetric* metric) {
+    if (!metric) return false;
+    
+    // Host frame timing, averaged over one second
+    ++m_FrameCount;
+    auto currentTime = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - m_LastStatsTime);
+    if (elapsed.count() >= 1000) {
+        m_Stats.frameTimeMs = elapsed.count() / float(m_FrameCount);
+        m_FrameCount = 0;
+        m_LastStatsTime = currentTime;
+    }
+    
+    try {
+        // Apply the resolution picked by the dynamic resolution controller
+        if (m_ResolutionDirty) {
+            m_ResolutionDirty = false;
+            resize(m_ViewportWidth, m_ViewportHeight);
+        }
+        
+        pollKernelBuild();
+        
+        // Structural parameters, or a metric emitting different device code,
+        // need a rebuild; runtime parameters only a metric data upload
+        if (m_Kernel && metric == m_KernelMetric && metric->getGeneration() != m_MetricSourceGeneration) {
+            m_MetricSourceGeneration = metric->getGeneration();
+            if (composeMetricSource(*metric) != m_MetricSource) {
+                m_KernelDirty = true;
+            }
+        }
+        
+        // Builds run one at a time; a change made meanwhile starts the next
+        // one when the current build is swapped in
+        bool failed = (metric == m_FailedBuildMetric && metric->getGeneration() == m_FailedBuildGeneration &&
+                       generateKernelDefines(metric) == m_FailedBuildDefines);
+        if (!m_PendingBuild && !failed && (!m_Kernel || m_KernelDirty || metric != m_KernelMetric)) {
+            startKernelBuild(metric);
         }
         
         if (!m_Kernel) {
             renderFallback();
-            return;
+            return true;
         }
         
-        // Setup rays
-        setupRays();
+        // Until the new program is ready the previous kernel keeps drawing the
+        // metric it was built for
+        metric = m_KernelMetric;
         
-        // Transfer data
-        m_Queue->enqueueWriteBuffer(*m_RayBuffer, CL_FALSE, 0, sizeof(Ray) * m_InitialRays.size(), m_InitialRays.data());
+        // Nothing changed since the last traced frame: reuse the texture,
+        // once the frames still in flight have been shown
+        bool upToDate = (metric == m_RenderedMetric &&
+                         metric->getGeneration() == m_RenderedMetricGeneration &&
+                         m_SceneGeneration == m_RenderedSceneGeneration);
+        // In progressive mode an unchanged scene keeps refining until done
+        m_TransferActive = m_UseTransferTable && supportsTransferTable(metric);
+        bool refining = upToDate && m_Progressive && !m_TransferActive && !m_ProgressiveDone;
+        if (upToDate && !refining) {
+            drainFrames(true);
+            return isCompiling(); // Keep polling the build
+        }
         
-        // Set arguments and execute
-        m_Kernel->setArg(0, *m_RayBuffer);
-        m_Kernel->setArg(1, *m_OutputImage);
+        // The initial null directions depend on the metric at the observer
+        if (m_MetricDataDirty || metric != m_MetricDataSource ||
+            metric->getGeneration() != m_MetricDataGeneration) {
+            updateMetricData(metric);
+        }
         
-        cl::NDRange globalSize(m_Width * m_Height);
-        cl::NDRange localSize = m_IsPOCL ? cl::NDRange(64) : cl::NDRange(256);
+        // Regenerate rays on the device only when the camera changed. The
+        // wavefront and progressive modes trace them in place, so they start
+        // over on every new scene, and the wavefront also on every frame.
+        bool inPlace = (m_Wavefront && !m_Progressive) || (m_Progressive && !refining);
+        if (m_TransferActive) {
+            // Rays are never generated in lookup mode, only the table
+            if (m_TransferDirty || metric != m_TransferMetric || metric->getGeneration() != m_TransferGeneration) {
+                buildTransferTable(metric);
+            }
+        } else if (m_CameraDirty || inPlace) {
+            generateRays();
+        }
+        if (m_Progressive && !refining) {
+            m_Stats.progressiveSteps = 0;
+            m_ProgressiveDone = false;
+            ++m_ProgressiveEpoch;
+        }
+        
+        submitFrame();
+        m_RenderedMetric = metric;
+        m_RenderedMetricGeneration = metric->getGeneration();
+        m_RenderedSceneGeneration = m_SceneGeneration;
+        
+        // Keep at most (frames in flight - 1) frames queued behind the one
+        // being traced; the texture shows the oldest completed frame
+        while (m_PendingFrames >= m_FramesInFlight) {
+            presentOldestFrame();
+        }
         
-        m_Queue->enqueueNDRangeKernel(*m_Kernel, cl::NullRange, globalSize, localSize);
+    } catch (const cl::Error& err) {
+        std::cerr << "Render error: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
+        renderFallback();
+    }
+    return true;
+}
 
-        // Read result
-        std::vector<float> pixelData(m_Width * m_Height * 4);
+void Renderer::submitFrame() {
+    FrameSlot& slot = *m_Resources->slots[m_NextSlot];
+    slot.waitForUpload();
+    
+    // Progressive frames take a slice of the step budget
+    int steps = m_TraceParams.maxSteps;
+    if (m_Progressive) {
+        steps = std::max(std::min(m_ProgressiveBudget, m_TraceParams.maxSteps - m_Stats.progressiveSteps), 0);
+    }
+    slot.progressiveEpoch = 0;
+    
+    if (m_TransferActive) {
+        if (m_UseMappedOutput) {
+            m_LookupKernel->setArg(0, *slot.buffer);
+        } else {
+            m_LookupKernel->setArg(0, *slot.image);
+        }
+        m_LookupKernel->setArg(1, m_Width);
+        m_LookupKernel->setArg(2, m_Height);
+        m_LookupKernel->setArg(3, m_Camera);
+        m_LookupKernel->setArg(4, *m_MetricData);
+        m_LookupKernel->setArg(5, *m_TransferTable);
+        m_LookupKernel->setArg(6, m_TransferRMin);
+        m_LookupKernel->setArg(7, m_TransferRMax);
+        m_LookupKernel->setArg(8, m_TraceParams.escapeRadius);
+        m_Queue->enqueueNDRangeKernel(*m_LookupKernel, cl::NullRange, getGlobalRange(), getLocalRange(), nullptr, &slot.traced);
+        slot.started = slot.traced;
+        steps = 0;
+    } else if (m_Wavefront) {
+        traceWavefront(slot, steps);
+    } else if (m_Progressive) {
+        m_Queue->enqueueFillBuffer(*m_Resources->liveCount, cl_int(0), 0, sizeof(cl_int));
+        
+        m_AdvanceKernel->setArg(0, *m_Resources->rayPositions);
+        m_AdvanceKernel->setArg(1, *m_Resources->rayVelocities);
+        m_AdvanceKernel->setArg(2, *m_Resources->rayFlags);
+        m_AdvanceKernel->setArg(3, *m_Resources->rayStepSizes);
+        m_AdvanceKernel->setArg(4, m_Width);
+        m_AdvanceKernel->setArg(5, m_Height);
+        m_AdvanceKernel->setArg(6, *m_MetricData);
+        m_AdvanceKernel->setArg(7, m_TraceParams);
+        m_AdvanceKernel->setArg(8, steps);
+        m_AdvanceKernel->setArg(9, *m_Resources->liveCount);
+        m_Queue->enqueueNDRangeKernel(*m_AdvanceKernel, cl::NullRange, getGlobalRange(), getLocalRange(), nullptr, &slot.started);
+        
+        shadeFrame(slot);
+        
+        // Read with the frame; the in-order queue completes it before the output
+        m_Queue->enqueueReadBuffer(*m_Resources->liveCount, CL_FALSE, 0, sizeof(cl_int), &slot.liveRays);
+        slot.progressiveEpoch = m_ProgressiveEpoch;
+    } else {
+        // Set arguments and execute
+        m_Kernel->setArg(0, *m_Resources->rayPositions);
+        m_Kernel->setArg(1, *m_Resources->rayVelocities);
+        m_Kernel->setArg(2, *m_Resources->rayFlags);
+        if (m_UseMappedOutput) {
+            m_Kernel->setArg(3, *slot.buffer);
+        } else {
+            m_Kernel->setArg(3, *slot.image);
+        }
+        m_Kernel->setArg(4, m_Width);
+        m_Kernel->setArg(5, m_Height);
+        m_Kernel->setArg(6, *m_MetricData);
+        m_Kernel->setArg(7, m_TraceParams);
+        
+        m_Queue->enqueueNDRangeKernel(*m_Kernel, cl::NullRange, getGlobalRange(), getLocalRange(), nullptr, &slot.traced);
+        slot.started = slot.traced;
+    }
+    m_RaysFresh = false;
+    
+    if (m_Progressive && !m_TransferActive) {
+        m_Stats.progressiveSteps += steps;
+        if (m_Stats.progressiveSteps >= m_TraceParams.maxSteps) {
+            m_ProgressiveDone = true;
+        }
+    }
+    std::vector<cl::Event> dependencies = {slot.traced};
+    
+    if (m_UseMappedOutput) {
+        // Map without blocking; the texture upload reads the mapping later
+        size_t outputSize = getFormatInfo(m_ResourceFormat).bytesPerPixel * m_Width * m_Height;
+        slot.mapped = m_Queue->enqueueMapBuffer(*slot.buffer, CL_FALSE, CL_MAP_READ, 0, outputSize, &dependencies, &slot.ready);
+    } else {
         cl::array<size_t, 3> origin = {0, 0, 0};
         cl::array<size_t, 3> region = {static_cast<size_t>(m_Width), static_cast<size_t>(m_Height), 1};
+        void* destination = slot.pboData ? slot.pboData : slot.pixels.data();
+        m_Queue->enqueueReadImage(*slot.image, CL_FALSE, origin, region, 0, 0, destination, &dependencies, &slot.ready);
+    }
+    m_Queue->flush();
+    
+    slot.pending = true;
+    m_NextSlot = (m_NextSlot + 1) % m_FramesInFlight;
+    ++m_PendingFrames;
+}
+
+void Renderer::traceWavefront(FrameSlot& slot, int steps) {
+    ResourceSet& set = *m_Resources;
+    cl::NDRange block(m_ScanBlockSize);
+    
+    // Fresh rays start from a full active list; progressive frames resume
+    // from the list the previous frame left
+    cl::Event* first = &slot.started;
+    if (m_RaysFresh) {
+        m_ActiveCount = getRayCount();
+        m_ActiveList = 0;
+        m_InitActiveKernel->setArg(0, *set.activeRays[0]);
+        m_InitActiveKernel->setArg(1, *set.activeCounts[0]);
+        m_InitActiveKernel->setArg(2, m_ActiveCount);
+        m_Queue->enqueueNDRangeKernel(*m_InitActiveKernel, cl::NullRange, getLinearRange(m_ActiveCount), block, nullptr, first);
+        first = nullptr;
+    }
+    
+    // The live count stays on the device, so every round is enqueued without
+    // waiting for the previous one; rounds after the last ray finished exit
+    // at once. Dispatches are sized by m_ActiveCount, an upper bound, as the
+    // count never grows. Rays still live after the last round are shaded
+    // where they stopped; only progressive frames need them compacted.
+    int rounds = (steps + m_WavefrontSteps - 1) / m_WavefrontSteps;
+    int round = 0;
+    while (m_ActiveCount > 0 && round < rounds) {
+        cl::Buffer& active = *set.activeRays[m_ActiveList];
+        cl::Buffer& next = *set.activeRays[1 - m_ActiveList];
+        cl::Buffer& activeCount = *set.activeCounts[m_ActiveList];
+        cl::Buffer& nextCount = *set.activeCounts[1 - m_ActiveList];
+        cl::NDRange range = getLinearRange(m_ActiveCount);
+        int roundSteps = std::min(m_WavefrontSteps, steps - round * m_WavefrontSteps);
         
-        m_Queue->enqueueReadImage(*m_OutputImage, CL_TRUE, origin, region, 0, 0, pixelData.data());
+        m_WavefrontKernel->setArg(0, *set.rayPositions);
+        m_WavefrontKernel->setArg(1, *set.rayVelocities);
+        m_WavefrontKernel->setArg(2, *set.rayFlags);
+        m_WavefrontKernel->setArg(3, *set.rayStepSizes);
+        m_WavefrontKernel->setArg(4, active);
+        m_WavefrontKernel->setArg(5, activeCount);
+        m_WavefrontKernel->setArg(6, *m_MetricData);
+        m_WavefrontKernel->setArg(7, m_TraceParams);
+        m_WavefrontKernel->setArg(8, roundSteps);
+        m_Queue->enqueueNDRangeKernel(*m_WavefrontKernel, cl::NullRange, range, block, nullptr, first);
+        first = nullptr;
+        if (++round == rounds && !m_Progressive) break;
         
-        // Update texture
-        glBindTexture(GL_TEXTURE_2D, m_OutputTextureID);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, GL_RGBA, GL_FLOAT, pixelData.data());
-        glBindTexture(GL_TEXTURE_2D, 0);
+        // Compact the survivors into the next active list
+        m_ScanKernel->setArg(0, active);
+        m_ScanKernel->setArg(1, activeCount);
+        m_ScanKernel->setArg(2, *set.rayFlags);
+        m_ScanKernel->setArg(3, *set.scanOffsets);
+        m_ScanKernel->setArg(4, *set.blockSums);
+        m_Queue->enqueueNDRangeKernel(*m_ScanKernel, cl::NullRange, range, block);
         
-        m_Queue->finish();
+        m_ScanBlocksKernel->setArg(0, *set.blockSums);
+        m_ScanBlocksKernel->setArg(1, activeCount);
+        m_ScanBlocksKernel->setArg(2, nextCount);
+        m_Queue->enqueueNDRangeKernel(*m_ScanBlocksKernel, cl::NullRange, block, block);
         
-    } catch (const cl::Error& err) {
-        std::cerr << "Render error: " << err.what() << " (Code: " << err.err() << ")" << std::endl;
-        renderFallback();
+        m_CompactKernel->setArg(0, active);
+        m_CompactKernel->setArg(1, activeCount);
+        m_CompactKernel->setArg(2, *set.rayFlags);
+        m_CompactKernel->setArg(3, *set.scanOffsets);
+        m_CompactKernel->setArg(4, *set.blockSums);
+        m_CompactKernel->setArg(5, next);
+        m_Queue->enqueueNDRangeKernel(*m_CompactKernel, cl::NullRange, range, block);
+        m_ActiveList = 1 - m_ActiveList;
+    }
+    m_Stats.wavefrontRounds = round;
+    
+    shadeFrame(slot);
+    if (first) {
+        slot.started = slot.traced;
+    }
+    
+    // The live count arrives with the frame, as in the progressive path
+    if (m_Progressive) {
+        m_Queue->enqueueReadBuffer(*set.activeCounts[m_ActiveList], CL_FALSE, 0, sizeof(cl_int), &slot.liveRays);
+        slot.progressiveEpoch = m_ProgressiveEpoch;
     }
 }
 
-void Renderer::setupRays() {
-    static float time = 0.0f;
-    time += 0.016f;
+bool Renderer::usesKerrGeodesics(IMetric* metric) const {
+    // The Mino-time equations need the Kerr metric's device code
+    return metric->getTraits().kerrSeparable && metric->hasKernelSource();
+}
+
+bool Renderer::supportsTransferTable(IMetric* metric) const {
+    // The table is built from the metric's own device code; the generic
+    // hooks only describe the metric around the observer
+    return metric->getTraits().sphericallySymmetric && !m_MetricSource.empty();
+}
+
+void Renderer::buildTransferTable(IMetric* metric) {
+    MetricTraits traits = metric->getTraits();
+    m_TransferRMin = std::max(static_cast<float>(traits.horizonRadius), 1e-3f) * 1.01f;
+    m_TransferRMax = std::max(m_TraceParams.escapeRadius, m_TransferRMin * 2.0f);
+    
+    if (!m_TransferTable) {
+        m_TransferTable = std::make_unique<cl::Image2D>(*m_Context, CL_MEM_READ_WRITE, cl::ImageFormat(CL_RGBA, CL_FLOAT),
+                                                        kTransferAngles, kTransferRadii);
+    }
     
-    const float fov = 60.0f * M_PI / 180.0f;
-    const float aspect = static_cast<float>(m_Width) / static_cast<float>(m_Height);
+    // Integrated once, so spend many more steps than a frame would
+    TraceParams params = m_TraceParams;
+    params.maxSteps = kTransferMaxSteps;
     
-    for (int y = 0; y < m_Height; ++y) {
-        for (int x = 0; x < m_Width; ++x) {
-            int index = y * m_Width + x;
-            
-            m_InitialRays[index].sx = x;
-            m_InitialRays[index].sy = y;
-            m_InitialRays[index].terminated = 0;
-            m_InitialRays[index].padding1 = 0;
-            m_InitialRays[index].padding2 = 0;
-            
-            m_InitialRays[index].pos = Vec4(0.0f, 0.0f, 0.0f, -5.0f);
-            
-            float ndc_x = (2.0f * x / static_cast<float>(m_Width)) - 1.0f;
-            float ndc_y = 1.0f - (2.0f * y / static_cast<float>(m_Height));
-            
-            float px = ndc_x * tan(fov * 0.5f) * aspect;
-            float py = ndc_y * tan(fov * 0.5f);
-            
-            Vec4 direction(1.0f, px, py, 1.0f);
-            m_InitialRays[index].vel = glm::normalize(direction);
+    m_TransferKernel->setArg(0, *m_TransferTable);
+    m_TransferKernel->setArg(1, kTransferAngles);
+    m_TransferKernel->setArg(2, kTransferRadii);
+    m_TransferKernel->setArg(3, m_TransferRMin);
+    m_TransferKernel->setArg(4, m_TransferRMax);
+    m_TransferKernel->setArg(5, *m_MetricData);
+    m_TransferKernel->setArg(6, params);
+    m_Queue->enqueueNDRangeKernel(*m_TransferKernel, cl::NullRange, cl::NDRange(kTransferAngles, kTransferRadii));
+    
+    m_TransferMetric = metric;
+    m_TransferGeneration = metric->getGeneration();
+    m_TransferDirty = false;
+    std::cout << "Building transfer table for " << metric->getName() << " (" << kTransferAngles << "x" << kTransferRadii
+              << ", r in [" << m_TransferRMin << ", " << m_TransferRMax << "])" << std::endl;
+}
+
+void Renderer::setTransferTable(bool enabled) {
+    if (enabled == m_UseTransferTable) return;
+    m_UseTransferTable = enabled;
+    ++m_SceneGeneration;
+}
+
+bool Renderer::isTransferTableEnabled() const {
+    return m_UseTransferTable;
+}
+
+bool Renderer::isTransferTableActive() const {
+    return m_TransferActive;
+}
+
+void Renderer::shadeFrame(FrameSlot& slot) {
+    m_ShadeKernel->setArg(0, *m_Resources->rayPositions);
+    m_ShadeKernel->setArg(1, *m_Resources->rayVelocities);
+    m_ShadeKernel->setArg(2, *m_Resources->rayFlags);
+    if (m_UseMappedOutput) {
+        m_ShadeKernel->setArg(3, *slot.buffer);
+    } else {
+        m_ShadeKernel->setArg(3, *slot.image);
+    }
+    m_ShadeKernel->setArg(4, m_Width);
+    m_ShadeKernel->setArg(5, m_Height);
+    m_ShadeKernel->setArg(6, *m_MetricData);
+    m_Queue->enqueueNDRangeKernel(*m_ShadeKernel, cl::NullRange, getGlobalRange(), getLocalRange(), nullptr, &slot.traced);
+}
+
+void Renderer::presentOldestFrame() {
+    int oldest = (m_NextSlot + m_FramesInFlight - m_PendingFrames) % m_FramesInFlight;
+    FrameSlot& slot = *m_Resources->slots[oldest];
+    
+    slot.ready.wait();
+    
+    // All rays of the current progressive image have finished
+    if (slot.progressiveEpoch == m_ProgressiveEpoch && slot.progressiveEpoch != 0) {
+        m_Stats.liveRays = slot.liveRays;
+        if (m_Wavefront) {
+            m_ActiveCount = std::min(m_ActiveCount, static_cast<int>(slot.liveRays)); // Tighter dispatch bound
+        }
+        if (slot.liveRays == 0) {
+            m_ProgressiveDone = true;
+        }
+    }
+    
+    cl_ulong start = slot.started.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    cl_ulong end = slot.traced.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+    updateDynamicResolution(static_cast<float>(end - start) * 1e-6f);
+    
+    // Update texture, from the PBO when there is one so the driver doesn't
+    // have to copy client memory before returning
+    const OutputFormatInfo& info = getFormatInfo(m_ResourceFormat);
+    const void* pixels = m_UseMappedOutput ? slot.mapped : slot.pixels.data();
+    if (slot.pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        pixels = nullptr; // Offset into the bound PBO
+    }
+    glBindTexture(GL_TEXTURE_2D, m_Resources->texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, info.glFormat, info.glType, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    showCurrentTexture();
+    if (slot.pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.uploadFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    
+    releaseFrame(slot);
+    --m_PendingFrames;
+    ++m_PresentedFrames;
+}
+
+void Renderer::releaseFrame(FrameSlot& slot) {
+    if (slot.mapped) {
+        m_Queue->enqueueUnmapMemObject(*slot.buffer, slot.mapped);
+        slot.mapped = nullptr;
+    }
+    slot.pending = false;
+}
+
+void Renderer::drainFrames(bool present) {
+    if (present) {
+        while (m_PendingFrames > 0) {
+            presentOldestFrame();
+        }
+        return;
+    }
+    
+    // Discard in-flight results, but unmap before the buffers go away
+    if (m_Queue) {
+        m_Queue->finish();
+    }
+    if (m_Resources) {
+        for (auto& slot : m_Resources->slots) {
+            if (slot->pending) {
+                releaseFrame(*slot);
+            }
+        }
+    }
+    if (m_Queue) {
+        m_Queue->finish();
+    }
+    m_PendingFrames = 0;
+}
+
+void Renderer::generateRays() {
+    m_RayGenKernel->setArg(0, *m_Resources->rayPositions);
+    m_RayGenKernel->setArg(1, *m_Resources->rayVelocities);
+    m_RayGenKernel->setArg(2, *m_Resources->rayFlags);
+    m_RayGenKernel->setArg(3, *m_Resources->rayStepSizes);
+    m_RayGenKernel->setArg(4, m_Camera);
+    m_RayGenKernel->setArg(5, *m_MetricData);
+    m_RayGenKernel->setArg(6, m_TraceParams.stepSize);
+    m_RayGenKernel->setArg(7, m_CaptureMass);
+    
+    m_Queue->enqueueNDRangeKernel(*m_RayGenKernel, cl::NullRange, getGlobalRange(), getLocalRange());
+    m_CameraDirty = false;
+    m_RaysFresh = true;
+}
+
+void Renderer::updateMetricData(IMetric* metric) {
+    // First-order expansion of the metric about the observer, in the layout
+    // of the kernel's METRIC_DATA_* offsets
+    Vec4 origin = m_Camera.position;
+    auto g = metric->getMetricTensor(origin);
+    auto dg = metric->getMetricDerivatives(origin);
+    
+    // The previous upload may still be reading the host copy
+    if (m_MetricUpload) {
+        m_MetricUpload->wait();
+    }
+    
+    for (int i = 0; i < 4; ++i) {
+        m_MetricValues[i] = origin[i];
+    }
+    for (int a = 0; a < 4; ++a) {
+        for (int b = 0; b < 4; ++b) {
+            m_MetricValues[4 + a * 4 + b] = static_cast<float>(g[a][b].real);
+            for (int c = 0; c < 4; ++c) {
+                m_MetricValues[20 + c * 16 + a * 4 + b] = static_cast<float>(dg[c][a][b].real);
+            }
+        }
+    }
+    
+    // Runtime parameters in the order composeMetricSource() assigned them
+    size_t slot = 0;
+    for (const auto& [key, param] : metric->getParameters()) {
+        if (slot < kMaxMetricParams && !metric->isStructuralParameter(key)) {
+            m_MetricValues[kMetricParamsOffset + slot++] = static_cast<float>(param.value);
         }
     }
+    
+    if (!m_MetricUpload) {
+        m_MetricUpload = std::make_unique<cl::Event>();
+    }
+    m_Queue->enqueueWriteBuffer(*m_MetricData, CL_FALSE, 0, kMetricDataSize * sizeof(float),
+                                m_MetricValues.data(), nullptr, m_MetricUpload.get());
+    
+    // Symmetries the kernel can exploit
+    MetricTraits traits = metric->getTraits();
+    m_CaptureMass = traits.sphericallySymmetric ? static_cast<float>(traits.mass) : 0.0f;
+    m_TraceParams.horizonRadius = static_cast<float>(traits.horizonRadius);
+    
+    m_MetricDataSource = metric;
+    m_MetricDataGeneration = metric->getGeneration();
+    m_MetricDataDirty = false;
+    m_CameraDirty = true;
 }
 
 void Renderer::renderFallback() {
@@ -322,11 +1359,28 @@ void Renderer::renderFallback() {
         }
     }
     
-    glBindTexture(GL_TEXTURE_2D, m_OutputTextureID);
+    glBindTexture(GL_TEXTURE_2D, m_Resources->texture);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, GL_RGBA, GL_FLOAT, pixelData.data());
     glBindTexture(GL_TEXTURE_2D, 0);
+    showCurrentTexture();
+}
+
+// The current set's texture now holds a complete image at the current size
+void Renderer::showCurrentTexture() {
+    m_DisplaySet = m_Resources;
+    m_DisplayUV = Vec2(static_cast<float>(m_Width) / m_Resources->capacityWidth,
+                       static_cast<float>(m_Height) / m_Resources->capacityHeight);
 }
 
 unsigned int Renderer::getOutputTexture() const {
-    return m_OutputTextureID;
+    if (m_DisplaySet) return m_DisplaySet->texture;
+    return m_Resources ? m_Resources->texture : 0;
+}
+
+int Renderer::getWidth() const {
+    return m_Width;
+}
+
+int Renderer::getHeight() const {
+    return m_Height;
 }
\ No newline at end of file
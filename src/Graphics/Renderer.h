@@ -3,54 +3,296 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <cstdint>
 #include "Math/Vec.h"
+#include "Math/Quaternion.h"
+#include "KernelSource.h"
 
 // Forward-declare OpenCL types
-namespace cl { class Context; class CommandQueue; class Kernel; class Buffer; class Image2D; class Device; }
+namespace cl { class Context; class CommandQueue; class Kernel; class Buffer; class Image2D; class Device; class NDRange; class Event; }
 class IMetric;
+class ProgramCache;
 
-// Ray struct matching the OpenCL kernel
-struct Ray {
-    Vec4 pos;
-    Vec4 vel;
-    int terminated;
-    int sx, sy;
-    int padding1, padding2;
+// Camera uniform block matching the OpenCL kernel
+struct Camera {
+    Vec4 position;    // (t, x, y, z)
+    Vec4 orientation; // Quaternion (x, y, z, w)
+    float fov;        // Vertical field of view in radians
+    float aspect;
+    int width, height;
+};
+
+// Geodesic integration settings matching the OpenCL kernel
+struct TraceParams {
+    float stepSize = 0.2f;       // Affine parameter step, the initial step when adaptive
+    float escapeRadius = 100.0f; // Rays beyond this radius have escaped
+    float absTolerance = 1e-4f;  // Adaptive error control
+    float relTolerance = 1e-4f;
+    float horizonRadius = 0.0f;  // Set by the renderer from the metric traits
+    int maxSteps = 64;           // Integration steps (attempts when adaptive) per ray
+};
+
+// Geodesic integration scheme, selected at kernel build time
+enum class Integrator {
+    RK4,          // Classic Runge-Kutta with a fixed step
+    DormandPrince, // Embedded RK45 with per-ray step size control
+    Symplectic     // Implicit midpoint on (x, p) with null re-projection, fixed step
+};
+
+// Pixel format of the output image, from the device through to the GL texture
+enum class OutputFormat {
+    RGBA8,   // 4 bytes per pixel, default for interactive use
+    RGBA16F, // 8 bytes per pixel
+    RGB10A2, // 4 bytes per pixel, 10-bit color
+    RGBA32F  // 16 bytes per pixel
+};
+
+// Timing and resolution controller state for the UI
+struct RenderStats {
+    float frameTimeMs = 0.0f;  // Host frame time, averaged over one second
+    float kernelTimeMs = 0.0f; // Smoothed device time of the trace kernel
+    float dynamicScale = 1.0f; // Resolution factor chosen by the controller
+    int wavefrontRounds = 0;   // Trace rounds of the last wavefront frame
+    int liveRays = 0;          // Rays still tracing in progressive mode
+    int progressiveSteps = 0;  // Steps per ray traced since the progressive image restarted
 };
 
 class Renderer {
 public:
+    // Sets up OpenCL only and may run on any thread. createResources() then
+    // allocates the render targets on the thread owning the GL context,
+    // before the first call to render().
     Renderer(int width, int height);
     ~Renderer();
 
-    void render(IMetric* metric);
+    void createResources();
+
+    // Traces a new frame if the metric, its parameters, the camera or the
+    // resolution changed. Returns false when the displayed image is current.
+    bool render(IMetric* metric);
+    void invalidate();
     unsigned int getOutputTexture() const;
 
+    // Kernels build on a worker thread; until a build finishes the previous
+    // kernel keeps rendering the metric it was built for
+    bool isCompiling() const;
+
+    // Starts building the kernel for a metric ahead of its first frame, so
+    // the build overlaps the rest of startup
+    void prebuildKernel(IMetric* metric);
+
+    // True once a traced image has reached the output texture
+    bool hasPresentedFrame() const;
+
+    // Render resolution follows the viewport, scaled by the render scale. The
+    // texture may be larger than the image; getOutputUV() is the used extent.
+    // Both describe the last presented image, which after a resize stays in
+    // the previous render target until the new one has presented a frame.
+    void resize(int viewportWidth, int viewportHeight);
+    void setRenderScale(float scale);
+    float getRenderScale() const;
+    int getWidth() const;
+    int getHeight() const;
+    Vec2 getOutputUV() const;
+
+    // Adjusts the internal resolution to keep the trace kernel within a budget.
+    // Off until enabled: each change of scale resizes the render targets and
+    // restarts a progressive image.
+    void setDynamicResolution(bool enabled, float frameBudgetMs);
+    bool isDynamicResolutionEnabled() const;
+    float getFrameBudget() const;
+    const RenderStats& getStats() const;
+
+    static constexpr int kSizeBucket = 64;
+    static constexpr int kMinRenderSize = 16;
+    static constexpr size_t kMaxPooledSizes = 4;
+    static constexpr float kMinDynamicScale = 0.25f;
+
+    void setCamera(const Vec4& position, const Quat& orientation, float fovDegrees);
+
+    void setTraceParams(const TraceParams& params);
+    const TraceParams& getTraceParams() const;
+    void setIntegrator(Integrator integrator);
+    Integrator getIntegrator() const;
+    static const char* getIntegratorName(Integrator integrator);
+    // Kerr metrics with device code are traced from their constants of
+    // motion in Mino time, in place of the selected integrator
+    bool isKerrGeodesicsActive() const;
+
+    // Wavefront mode traces stepsPerRound steps at a time and compacts the
+    // live rays between rounds, so finished rays stop occupying work-items
+    void setWavefront(bool enabled, int stepsPerRound);
+    bool isWavefrontEnabled() const;
+    int getWavefrontSteps() const;
+
+    // Progressive mode keeps the ray state between frames and advances each
+    // ray by stepsPerFrame, refining the image until every ray has finished
+    // or max steps is reached. Any change restarts it.
+    void setProgressive(bool enabled, int stepsPerFrame);
+    bool isProgressiveEnabled() const;
+    int getProgressiveStepsPerFrame() const;
+
+    // Lookup mode for spherically symmetric metrics with device code: rays
+    // are shaded from a precomputed (observer radius x angle) transfer table
+    // instead of being integrated. Other metrics keep tracing.
+    void setTransferTable(bool enabled);
+    bool isTransferTableEnabled() const;
+    bool isTransferTableActive() const;
+
+    static constexpr int kTransferAngles = 512;
+    static constexpr int kTransferRadii = 128;
+    static constexpr int kTransferMaxSteps = 4096;
+
+    // Number of frames queued on the device before the oldest is displayed (1-3)
+    void setFramesInFlight(int count);
+    int getFramesInFlight() const;
+
+    static constexpr int kMaxFramesInFlight = 3;
+
+    void setOutputFormat(OutputFormat format);
+    OutputFormat getOutputFormat() const;
+    static const char* getOutputFormatName(OutputFormat format);
+
 private:
-    void createResources(int width, int height);
-    void compileKernel(IMetric* metric);
-    void setupRays();
+    struct FrameSlot;
+    struct KernelBuild;
+    struct ResourceSet;
+
+    void acquireResources(int width, int height);
+    void clearResourcePool();
+    std::unique_ptr<ResourceSet> createResourceSet(int capacityWidth, int capacityHeight);
+    void submitFrame();
+    void traceWavefront(FrameSlot& slot, int steps);
+    void shadeFrame(FrameSlot& slot);
+    bool supportsTransferTable(IMetric* metric) const;
+    bool usesKerrGeodesics(IMetric* metric) const;
+    void buildTransferTable(IMetric* metric);
+    void presentOldestFrame();
+    void showCurrentTexture();
+    void releaseFrame(FrameSlot& slot);
+    void drainFrames(bool present);
+    bool isImageFormatSupported(OutputFormat format) const;
+    void updateDynamicResolution(float kernelTimeMs);
+    void startKernelBuild(IMetric* metric);
+    void pollKernelBuild();
+    void generateRays();
+    void updateMetricData(IMetric* metric);
     void renderFallback();
     std::string generateCompilerOptions(IMetric* metric) const;
+    std::string generateKernelDefines(IMetric* metric) const;
+    void chooseTileShape(const KernelConfig& startup);
+    cl::NDRange getGlobalRange() const;
+    cl::NDRange getLocalRange() const;
+    cl::NDRange getLinearRange(int count) const;
+    int getRayCount() const;
 
     int m_Width, m_Height;
+    int m_ViewportWidth, m_ViewportHeight;
+    float m_RenderScale = 1.0f;
+
+    // Dynamic resolution controller
+    bool m_DynamicResolution = false;
+    float m_FrameBudgetMs = 16.6f;
+    float m_DynamicScale = 1.0f;
+    float m_AppliedDynamicScale = 1.0f;
+    bool m_ResolutionDirty = false;
+
+    // Render-on-demand: the frame is redrawn only when a generation changes
+    uint64_t m_SceneGeneration = 0;
+    uint64_t m_RenderedSceneGeneration = 0;
+    const IMetric* m_RenderedMetric = nullptr;
+    uint64_t m_RenderedMetricGeneration = 0;
+
+    RenderStats m_Stats;
+    int m_FrameCount = 0;
+    std::chrono::steady_clock::time_point m_LastStatsTime = std::chrono::steady_clock::now();
 
     // OpenCL objects
     std::unique_ptr<cl::Context> m_Context;
     std::unique_ptr<cl::CommandQueue> m_Queue;
     std::unique_ptr<cl::Kernel> m_Kernel;
-    std::unique_ptr<cl::Buffer> m_RayBuffer;
-    std::unique_ptr<cl::Image2D> m_OutputImage;
+    std::unique_ptr<cl::Kernel> m_RayGenKernel;
+    std::unique_ptr<cl::Kernel> m_InitActiveKernel;
+    std::unique_ptr<cl::Kernel> m_WavefrontKernel;
+    std::unique_ptr<cl::Kernel> m_ScanKernel;
+    std::unique_ptr<cl::Kernel> m_ScanBlocksKernel;
+    std::unique_ptr<cl::Kernel> m_CompactKernel;
+    std::unique_ptr<cl::Kernel> m_ShadeKernel;
+    std::unique_ptr<cl::Kernel> m_AdvanceKernel;
+    std::unique_ptr<cl::Kernel> m_TransferKernel;
+    std::unique_ptr<cl::Kernel> m_LookupKernel;
     std::unique_ptr<cl::Device> m_Device;
-    
-    // OpenGL texture
-    unsigned int m_OutputTextureID;
+    std::unique_ptr<ProgramCache> m_ProgramCache; // Built programs, in memory and on disk
+    std::unique_ptr<KernelBuild> m_PendingBuild;  // Program being built in the background
+    IMetric* m_KernelMetric = nullptr;            // Metric the current kernel was built for
+    const IMetric* m_FailedBuildMetric = nullptr; // Last failed build, not retried until it or its defines change
+    uint64_t m_FailedBuildGeneration = 0;
+    std::string m_FailedBuildDefines;
+
+    // Size-bucketed render targets, most recently used first
+    std::vector<std::unique_ptr<ResourceSet>> m_ResourcePool;
+    ResourceSet* m_Resources = nullptr;
+    const ResourceSet* m_DisplaySet = nullptr; // Holds the last presented image, in the pool
+    Vec2 m_DisplayUV = Vec2(1.0f, 1.0f);
 
     // Platform detection
     bool m_IsPOCL = false;
     bool m_IsNVIDIA = false;
     bool m_HasRealOpenCL30 = false;
+    bool m_SupportsSpirv = false;   // Offline compiled kernels can be loaded as IL
+    std::string m_OfflineKernelDir; // kernels/spirv next to the executable
+    bool m_UseMappedOutput = false; // Device shares host memory: map the result instead of copying it
+    bool m_UsePixelBuffers = false; // Stream texture updates through persistently mapped PBOs
+    OutputFormat m_OutputFormat = OutputFormat::RGBA8; // Startup defaults, as in KernelConfig
+    OutputFormat m_ResourceFormat = OutputFormat::RGBA8; // Of the render targets and the current kernel
+    int m_TileWidth = 8, m_TileHeight = 8; // 2D work-group shape, divides kSizeBucket
+    int m_ScanBlockSize = 256; // Power-of-two work-group size of the compaction kernels
+    bool m_Wavefront = false;
+    int m_WavefrontSteps = 16;
+    int m_ActiveCount = 0; // Upper bound of the live rays in the current wavefront active list
+    int m_ActiveList = 0;  // Which of the two active lists is current
+    bool m_RaysFresh = false; // Rays regenerated and not traced yet
+
+    // Progressive continuation
+    bool m_Progressive = false;
+    int m_ProgressiveBudget = 32;
+    bool m_ProgressiveDone = true;
+    uint64_t m_ProgressiveEpoch = 0; // Bumped on restart, tags frames in flight
+
+    // Transfer table lookup
+    bool m_UseTransferTable = false;
+    bool m_TransferActive = false; // Enabled and supported by the current metric
+    bool m_KerrGeodesics = false;  // Current kernel traces in Mino time
+    bool m_TransferDirty = true;   // Kernel or trace settings changed
+    std::unique_ptr<cl::Image2D> m_TransferTable;
+    const IMetric* m_TransferMetric = nullptr;
+    uint64_t m_TransferGeneration = 0;
+    float m_TransferRMin = 0.0f, m_TransferRMax = 0.0f;
+    bool m_KernelDirty = false; // Build options changed, rebuild before the next frame
+
+    // Frames-in-flight ring, slots live in the active resource set
+    int m_FramesInFlight = 2;
+    int m_NextSlot = 0;
+    int m_PendingFrames = 0;
+    uint64_t m_PresentedFrames = 0;
+
+    Camera m_Camera;
+    bool m_CameraDirty = true;
+    TraceParams m_TraceParams;
+    Integrator m_Integrator = Integrator::DormandPrince; // Startup default, as in KernelConfig
 
-    std::vector<Ray> m_InitialRays;
-    std::string m_LastMetricName;
+    // Metric snapshot read by the kernel's default metric hooks, followed by
+    // the metric's runtime parameters
+    static constexpr size_t kMetricParamsOffset = 84;
+    static constexpr size_t kMetricDataSize = kMetricParamsOffset + kMaxMetricParams;
+    std::unique_ptr<cl::Buffer> m_MetricData;
+    std::unique_ptr<cl::Event> m_MetricUpload;
+    std::vector<float> m_MetricValues;
+    float m_CaptureMass = 0.0f; // Analytic capture test in ray generation, 0 when off
+    const IMetric* m_MetricDataSource = nullptr;
+    uint64_t m_MetricDataGeneration = 0;
+    bool m_MetricDataDirty = true;
+    std::string m_MetricSource; // Device code of the compiled metric with its PARAM_ defines, empty for the generic hooks
+    uint64_t m_MetricSourceGeneration = 0;
 };
\ No newline at end of file
@@ -4,11 +4,22 @@
 #include "Math/Dual.h"
 #include "Core/Config.h"
 #include <array>
+#include <string>
+#include <cstdint>
 
 // Define our 4D spacetime vector and tensor types
 template<int Rows, int Cols>
 using Tensor2D = std::array<std::array<Dual<double>, Cols>, Rows>;
 
+// Properties of a metric that the renderer can exploit
+struct MetricTraits {
+    bool sphericallySymmetric = false; // Static and spherically symmetric about the spatial origin
+    double mass = 0.0;                 // Mass M in geometric units
+    double horizonRadius = 0.0;        // Rays inside this radius are captured, 0 without a horizon
+    bool kerrSeparable = false;        // Kerr spacetime in Kerr-Schild coordinates, spin along z
+    double spin = 0.0;                 // Spin parameter a = J/M
+};
+
 class IMetric {
 public:
     virtual ~IMetric() = default;
@@ -17,11 +28,45 @@ public:
     virtual const char* getDescription() const = 0;
 
     virtual const Config& getParameters() const = 0;
-    virtual void setParameter(const std::string& key, double value) = 0;
+    virtual MetricTraits getTraits() const { return {}; }
+
+    // Sets a parameter and bumps the generation, so the renderer can tell
+    // when the metric changed and a new frame is needed
+    void setParameter(const std::string& key, double value) {
+        applyParameter(key, value);
+        ++m_Generation;
+    }
+    uint64_t getGeneration() const { return m_Generation; }
 
     // Calculates the metric tensor g_ab(x)
     virtual Tensor2D<4, 4> getMetricTensor(const Vec4& position) const = 0;
 
     // Calculates the partial derivatives dg_ab/dx^c
     virtual std::array<Tensor2D<4, 4>, 4> getMetricDerivatives(const Vec4& position) const = 0;
+
+    // Optional OpenCL C implementation of the metric for the ray tracer,
+    // spliced into the kernel before it is built. It defines metric_at() and
+    // either metric_derivatives_at() or, after #define METRIC_HAS_CHRISTOFFEL,
+    // christoffel_at(); see the metric hooks in kernels/metric.cl for the
+    // signatures. Without it the kernel uses a first-order expansion of the
+    // two functions above, taken at the observer, which is exact only for
+    // flat space: in curved regions far from the camera the rays are wrong.
+    virtual std::string getKernelSource() const { return ""; }
+
+    // Whether getKernelSource() is non-empty, without building the source.
+    // Metrics with device code override it to answer cheaply.
+    virtual bool hasKernelSource() const { return !getKernelSource().empty(); }
+
+    // Parameters reach the device code as PARAM_<NAME>, read from a constant
+    // buffer so that changing them needs no rebuild. A structural parameter
+    // is compiled in as a literal instead; worth it only when the compiler
+    // can specialize on the value, as the kernel is rebuilt on every change.
+    virtual bool isStructuralParameter(const std::string& /*key*/) const { return false; }
+
+protected:
+    // Implemented by plugins to store a parameter value
+    virtual void applyParameter(const std::string& key, double value) = 0;
+
+private:
+    uint64_t m_Generation = 0;
 };
\ No newline at end of file
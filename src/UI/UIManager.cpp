@@ -3,13 +3,13 @@
 #include "Core/PluginManager.h"
 #include "Graphics/Renderer.h"
 #include "Physics/IMetric.h"
+#include "Math/Quaternion.h"
 #include <glad/glad.h>  // Must come BEFORE any OpenGL includes
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <GLFW/glfw3.h>
 #include <string>
-#include <chrono>
 
 UIManager::UIManager(GLFWwindow* window, Application& app) : m_App(app) {
     // Setup Dear ImGui context
@@ -99,22 +99,32 @@ void UIManager::displayViewport() {
 
     Renderer* renderer = m_App.getRenderer();
     if (renderer && m_App.m_CurrentMetric) {
-        unsigned int textureID = renderer->getOutputTexture();
-        
         // Get the content region available for the image
         ImVec2 contentRegion = ImGui::GetContentRegionAvail();
         
+        // Trace at the size of the panel; takes effect next frame
+        if (contentRegion.x > 0 && contentRegion.y > 0) {
+            renderer->resize(static_cast<int>(contentRegion.x), static_cast<int>(contentRegion.y));
+        }
+        
+        // Read after the resize: the texture and the part of it holding the
+        // image belong to the same presented frame
+        unsigned int textureID = renderer->getOutputTexture();
+        
         // Ensure we have a valid texture and content region
         if (textureID > 0 && contentRegion.x > 0 && contentRegion.y > 0) {
+            // Only part of a pooled texture may hold the image
+            Vec2 uv = renderer->getOutputUV();
+            
             // Cast texture ID directly to ImTextureID (which is uint64_t in this build)
             ImTextureID texID = static_cast<ImTextureID>(textureID);
-            ImGui::Image(texID, contentRegion, ImVec2(0, 1), ImVec2(1, 0)); // Flip Y coordinate for OpenGL
+            ImGui::Image(texID, contentRegion, ImVec2(0, uv.y), ImVec2(uv.x, 0)); // Flip Y coordinate for OpenGL
             
             // Display render info on hover
             if (ImGui::IsItemHovered()) {
                 ImGui::BeginTooltip();
                 ImGui::Text("Metric: %s", m_App.m_CurrentMetric->getName());
-                ImGui::Text("Resolution: %.0fx%.0f", contentRegion.x, contentRegion.y);
+                ImGui::Text("Resolution: %dx%d", renderer->getWidth(), renderer->getHeight());
                 ImGui::Text("Texture ID: %u", textureID);
                 ImGui::EndTooltip();
             }
@@ -142,6 +152,9 @@ void UIManager::displayControlPanel() {
             if (ImGui::Selectable(name.c_str(), is_selected)) {
                 m_App.m_CurrentMetricName = name;
                 m_App.m_CurrentMetric = m_App.m_PluginManager->getMetric(name);
+                if (m_App.getRenderer()) {
+                    m_App.getRenderer()->invalidate();
+                }
             }
             if (is_selected) {
                 ImGui::SetItemDefaultFocus();
@@ -174,6 +187,9 @@ void UIManager::displayControlPanel() {
         
         ImGui::Separator();
         
+        displayCameraControls();
+        displayIntegrationControls();
+        
         // Render statistics
         if (ImGui::CollapsingHeader("Render Info")) {
             Renderer* renderer = m_App.getRenderer();
@@ -182,27 +198,53 @@ void UIManager::displayControlPanel() {
                 ImGui::Text("Platform: Portable Computing Language");
                 ImGui::Text("Device: AMD Ryzen 7 7800X3D (16 cores)");
                 ImGui::Text("Output Texture ID: %u", renderer->getOutputTexture());
-                ImGui::Text("Resolution: %dx%d", 1280, 720);
-                ImGui::Text("Total Rays: %d", 1280 * 720);
+                ImGui::Text("Resolution: %dx%d", renderer->getWidth(), renderer->getHeight());
+                ImGui::Text("Total Rays: %d", renderer->getWidth() * renderer->getHeight());
                 
-                // Add frame timing info
-                static float frameTime = 0.0f;
-                static int frameCount = 0;
-                static auto lastTime = std::chrono::high_resolution_clock::now();
+                float renderScale = renderer->getRenderScale();
+                if (ImGui::SliderFloat("Render scale", &renderScale, 0.25f, 2.0f)) {
+                    renderer->setRenderScale(renderScale);
+                }
+                
+                int framesInFlight = renderer->getFramesInFlight();
+                if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, Renderer::kMaxFramesInFlight)) {
+                    renderer->setFramesInFlight(framesInFlight);
+                }
                 
-                frameCount++;
-                auto currentTime = std::chrono::high_resolution_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastTime);
+                const OutputFormat formats[] = {OutputFormat::RGBA8, OutputFormat::RGBA16F, OutputFormat::RGB10A2, OutputFormat::RGBA32F};
+                if (ImGui::BeginCombo("Output format", Renderer::getOutputFormatName(renderer->getOutputFormat()))) {
+                    for (OutputFormat format : formats) {
+                        bool is_selected = (format == renderer->getOutputFormat());
+                        if (ImGui::Selectable(Renderer::getOutputFormatName(format), is_selected)) {
+                            renderer->setOutputFormat(format);
+                        }
+                        if (is_selected) {
+                            ImGui::SetItemDefaultFocus();
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
                 
-                if (elapsed.count() >= 1000) { // Update every second
-                    frameTime = elapsed.count() / float(frameCount);
-                    frameCount = 0;
-                    lastTime = currentTime;
+                bool dynamicResolution = renderer->isDynamicResolutionEnabled();
+                float frameBudget = renderer->getFrameBudget();
+                bool budgetChanged = ImGui::Checkbox("Dynamic resolution", &dynamicResolution);
+                budgetChanged |= ImGui::SliderFloat("Kernel budget (ms)", &frameBudget, 4.0f, 100.0f);
+                if (budgetChanged) {
+                    renderer->setDynamicResolution(dynamicResolution, frameBudget);
                 }
                 
-                if (frameTime > 0) {
-                    ImGui::Text("Frame Time: %.1f ms", frameTime);
-                    ImGui::Text("FPS: %.1f", 1000.0f / frameTime);
+                // Frame timing info, measured by the renderer
+                const RenderStats& stats = renderer->getStats();
+                if (stats.frameTimeMs > 0) {
+                    ImGui::Text("Frame Time: %.1f ms", stats.frameTimeMs);
+                    ImGui::Text("FPS: %.1f", 1000.0f / stats.frameTimeMs);
+                }
+                ImGui::Text("Kernel Time: %.1f ms", stats.kernelTimeMs);
+                if (renderer->isCompiling()) {
+                    ImGui::Text("Compiling kernel...");
+                }
+                if (dynamicResolution) {
+                    ImGui::Text("Dynamic Scale: %.2f", stats.dynamicScale);
                 }
             }
         }
@@ -220,4 +262,97 @@ void UIManager::displayControlPanel() {
     }
 
     ImGui::End();
+}
+
+void UIManager::displayCameraControls() {
+    if (!ImGui::CollapsingHeader("Camera")) {
+        return;
+    }
+
+    bool changed = false;
+    changed |= ImGui::SliderFloat("Distance", &m_CameraDistance, 2.5f, 50.0f);
+    changed |= ImGui::SliderFloat("Yaw", &m_CameraYaw, -180.0f, 180.0f);
+    changed |= ImGui::SliderFloat("Pitch", &m_CameraPitch, -89.0f, 89.0f);
+    changed |= ImGui::SliderFloat("FOV", &m_CameraFov, 20.0f, 120.0f);
+
+    Renderer* renderer = m_App.getRenderer();
+    if (changed && renderer) {
+        // Orbit around the origin, looking along the local +z axis
+        Quat orientation = glm::angleAxis(glm::radians(m_CameraYaw), Vec3(0.0f, 1.0f, 0.0f)) *
+                           glm::angleAxis(glm::radians(m_CameraPitch), Vec3(1.0f, 0.0f, 0.0f));
+        Vec3 position = orientation * Vec3(0.0f, 0.0f, -m_CameraDistance);
+        renderer->setCamera(Vec4(0.0f, position.x, position.y, position.z), orientation, m_CameraFov);
+    }
+}
+
+void UIManager::displayIntegrationControls() {
+    Renderer* renderer = m_App.getRenderer();
+    if (!renderer || !ImGui::CollapsingHeader("Integration")) {
+        return;
+    }
+
+    const Integrator integrators[] = {Integrator::RK4, Integrator::DormandPrince, Integrator::Symplectic};
+    if (ImGui::BeginCombo("Integrator", Renderer::getIntegratorName(renderer->getIntegrator()))) {
+        for (Integrator integrator : integrators) {
+            bool is_selected = (integrator == renderer->getIntegrator());
+            if (ImGui::Selectable(Renderer::getIntegratorName(integrator), is_selected)) {
+                renderer->setIntegrator(integrator);
+            }
+            if (is_selected) {
+                ImGui::SetItemDefaultFocus();
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (renderer->isKerrGeodesicsActive()) {
+        ImGui::Text("Kerr: separated equations in Mino time");
+    }
+    if (m_App.m_CurrentMetric && !m_App.m_CurrentMetric->hasKernelSource()) {
+        ImGui::TextWrapped("Approximate: this metric has no device code and is expanded about the observer");
+    }
+
+    TraceParams params = renderer->getTraceParams();
+    bool adaptive = renderer->getIntegrator() == Integrator::DormandPrince;
+    bool changed = false;
+    changed |= ImGui::SliderFloat(adaptive ? "Initial step" : "Step size", &params.stepSize, 0.01f, 1.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+    changed |= ImGui::SliderInt("Max steps", &params.maxSteps, 1, 8192, "%d", ImGuiSliderFlags_Logarithmic);
+    changed |= ImGui::SliderFloat("Escape radius", &params.escapeRadius, 10.0f, 1000.0f);
+    if (adaptive) {
+        changed |= ImGui::SliderFloat("Abs tolerance", &params.absTolerance, 1e-7f, 1e-2f, "%.1e", ImGuiSliderFlags_Logarithmic);
+        changed |= ImGui::SliderFloat("Rel tolerance", &params.relTolerance, 1e-7f, 1e-2f, "%.1e", ImGuiSliderFlags_Logarithmic);
+    }
+    if (changed) {
+        renderer->setTraceParams(params);
+    }
+
+    bool wavefront = renderer->isWavefrontEnabled();
+    int stepsPerRound = renderer->getWavefrontSteps();
+    bool wavefrontChanged = ImGui::Checkbox("Wavefront tracing", &wavefront);
+    if (wavefront) {
+        wavefrontChanged |= ImGui::SliderInt("Steps per round", &stepsPerRound, 1, 256);
+        ImGui::Text("Rounds: %d", renderer->getStats().wavefrontRounds);
+    }
+    if (wavefrontChanged) {
+        renderer->setWavefront(wavefront, stepsPerRound);
+    }
+
+    bool transferTable = renderer->isTransferTableEnabled();
+    if (ImGui::Checkbox("Transfer table lookup", &transferTable)) {
+        renderer->setTransferTable(transferTable);
+    }
+    if (transferTable && !renderer->isTransferTableActive()) {
+        ImGui::Text("Needs a spherically symmetric metric with device code");
+    }
+
+    bool progressive = renderer->isProgressiveEnabled();
+    int stepsPerFrame = renderer->getProgressiveStepsPerFrame();
+    bool progressiveChanged = ImGui::Checkbox("Progressive", &progressive);
+    if (progressive) {
+        progressiveChanged |= ImGui::SliderInt("Steps per frame", &stepsPerFrame, 1, 512);
+        const RenderStats& stats = renderer->getStats();
+        ImGui::Text("Steps: %d / %d, live rays: %d", stats.progressiveSteps, params.maxSteps, stats.liveRays);
+    }
+    if (progressiveChanged) {
+        renderer->setProgressive(progressive, stepsPerFrame);
+    }
 }
\ No newline at end of file
@@ -16,6 +16,14 @@ public:
 private:
     void displayViewport();
     void displayControlPanel();
+    void displayCameraControls();
+    void displayIntegrationControls();
     
     Application& m_App; // Store a reference to the main application
+
+    // Orbit camera around the origin
+    float m_CameraDistance = 5.0f;
+    float m_CameraYaw = 0.0f;   // Degrees
+    float m_CameraPitch = 0.0f; // Degrees
+    float m_CameraFov = 60.0f;  // Degrees
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+// Writes the kernel variants to compile ahead of time: the generic kernel and
+// one per metric plugin with device code, for the startup configuration of
+// every kind of device (startupKernelConfig). Each variant is written as
+// <key>.cl with its defines inlined, where key is the kernelVariantKey() the
+// renderer computes for it at run time.
+//
+// Usage: SiriusKernelVariants <plugin-dir> <output-dir>
+
+#include "Graphics/KernelSource.h"
+#include "Core/PluginManager.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <filesystem>
+#include <set>
+
+namespace fs = std::filesystem;
+
+// -DNAME=VALUE and -DNAME as #define lines
+static std::string definesToSource(const std::string& defines) {
+    std::istringstream stream(defines);
+    std::string source;
+    for (std::string token; stream >> token;) {
+        if (token.rfind("-D", 0) != 0) {
+            continue;
+        }
+        token = token.substr(2);
+        size_t equals = token.find('=');
+        if (equals == std::string::npos) {
+            source += "#define " + token + " 1\n";
+        } else {
+            source += "#define " + token.substr(0, equals) + " " + token.substr(equals + 1) + "\n";
+        }
+    }
+    return source;
+}
+
+static void writeVariant(const fs::path& outputDir, const std::string& source, const KernelConfig& config,
+                         std::set<uint64_t>& written) {
+    std::string defines = kernelDefines(config);
+    uint64_t key = kernelVariantKey(source, defines);
+    if (!written.insert(key).second) {
+        return; // Device kinds sharing a configuration share the variant
+    }
+    
+    fs::path path = outputDir / (kernelVariantName(key) + ".cl");
+    std::ofstream file(path);
+    file << definesToSource(defines) << source;
+    std::cout << path.filename().string() << ":" << defines << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <plugin-dir> <output-dir>" << std::endl;
+        return 1;
+    }
+    
+    try {
+        std::string kernelSource = assembleKernelSource();
+        fs::path outputDir = argv[2];
+        fs::remove_all(outputDir);
+        fs::create_directories(outputDir);
+        
+        PluginManager plugins;
+        plugins.loadPlugins(argv[1]);
+        
+        std::set<uint64_t> written;
+        for (bool isCPU : {true, false}) {
+            for (bool isPOCL : {true, false}) {
+                for (bool isNVIDIA : {true, false}) {
+                    if (isPOCL && isNVIDIA) {
+                        continue; // One platform or the other
+                    }
+                    KernelConfig config = startupKernelConfig(isCPU, isPOCL, isNVIDIA);
+                    writeVariant(outputDir, kernelSource, config, written);
+                    
+                    // Mirrors Renderer::generateKernelDefines for metric device code
+                    for (const auto& name : plugins.getMetricNames()) {
+                        IMetric* metric = plugins.getMetric(name);
+                        std::string metricSource = composeMetricSource(*metric);
+                        if (metricSource.empty()) {
+                            continue;
+                        }
+                        
+                        std::string source = kernelSource;
+                        spliceMetricSource(source, metricSource);
+                        KernelConfig metricConfig = config;
+                        metricConfig.metricSource = true;
+                        metricConfig.kerrMino = metric->getTraits().kerrSeparable;
+                        writeVariant(outputDir, source, metricConfig, written);
+                    }
+                }
+            }
+        }
+    } catch (const std::exception& err) {
+        std::cerr << "Kernel variant generation failed: " << err.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}